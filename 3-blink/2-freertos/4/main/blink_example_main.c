@@ -0,0 +1,95 @@
+/* Blink Example
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "led_render.h"
+#include "led_strip.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+
+#include "driver/uart.h"
+#include "esp_vfs_dev.h"
+
+static const char *TAG = "example";
+
+/* Use project configuration menu (idf.py menuconfig) to choose the GPIO to
+   blink, or you can edit the following line and set a number here.
+*/
+#define BLINK_GPIO CONFIG_BLINK_GPIO
+
+static uint8_t s_led_state = 0;
+
+// The render service is the only owner of the LED strip: the tasks below never
+// touch it directly, they post commands to the render service instead.
+static led_render_t *g_render;
+
+static void configure_led(void) {
+  ESP_LOGI(TAG, "Example configured to blink addressable LED!");
+  /* LED strip initialization with the GPIO and pixels number*/
+  led_strip_t *pStrip_a =
+      led_strip_init(CONFIG_BLINK_LED_RMT_CHANNEL, BLINK_GPIO, 1);
+  /* Hand the strip over to the render service */
+  led_render_config_t config = LED_RENDER_DEFAULT_CONFIG(pStrip_a, 1);
+  ESP_ERROR_CHECK(led_render_start(&config, &g_render));
+  // Use these RGB values as default. I picked them from UniBZ's logo.
+  led_render_set_pixel(g_render, 0, 9, 115, 186);
+}
+
+static void led_blink_task(void *params) {
+  while (1) {
+    ESP_LOGI(TAG, "Turning the LED %s!", s_led_state == true ? "ON" : "OFF");
+
+    // No need to know the current color: blanking keeps the pixels, so
+    // unblanking shows again whatever color was set last.
+    led_render_blank(g_render, !s_led_state);
+
+    /* Toggle the LED state */
+    s_led_state = !s_led_state;
+    vTaskDelay(CONFIG_BLINK_PERIOD / portTICK_PERIOD_MS);
+  }
+}
+
+static void input_task(void *params) {
+  // To make scanf work
+  // See https://esp32.com/viewtopic.php?t=22929#p82561
+  setvbuf(stdin, NULL, _IONBF, 0);
+  setvbuf(stdout, NULL, _IONBF, 0);
+  ESP_ERROR_CHECK(
+      uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0));
+  esp_vfs_dev_uart_use_driver(CONFIG_ESP_CONSOLE_UART_NUM);
+  esp_vfs_dev_uart_port_set_rx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM,
+                                            ESP_LINE_ENDINGS_CR);
+  esp_vfs_dev_uart_port_set_tx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM,
+                                            ESP_LINE_ENDINGS_CRLF);
+  int red, green, blue;
+  while (1) {
+    printf("Insert red intensity\n");
+    scanf("%d", &red);
+    printf("Insert green intensity\n");
+    scanf("%d", &green);
+    printf("Insert blue intensity\n");
+    scanf("%d", &blue);
+    printf("RGB: (%d, %d, %d)\n", red, green, blue);
+
+    // Posting never blocks: not even while the render task is refreshing
+    led_render_set_pixel(g_render, 0, red, green, blue);
+  }
+}
+
+void app_main(void) {
+  /* Configure the peripheral according to the LED type */
+  configure_led();
+
+  xTaskCreate(led_blink_task, NULL, 0x1024, NULL, tskIDLE_PRIORITY + 1, NULL);
+  // Try to change 0x1024 to 0x512 and then build and flash. You'll witness a
+  // stack overflow!
+  xTaskCreate(input_task, NULL, 0x1024, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "led_strip.h"
+
+/**
+* @brief Render service Type
+*
+* @note The render service runs a task that is the only owner of a LED strip.
+*       Any other task changes the LEDs by posting commands to it, which is
+*       safe to do concurrently from any number of tasks and never blocks.
+*/
+typedef struct led_render_s led_render_t;
+
+/**
+* @brief Render service Configuration Type
+*
+*/
+typedef struct {
+    led_strip_t *strip;          /*!< LED strip, owned by the render task from now on */
+    uint32_t led_num;            /*!< Number of LEDs of the strip */
+    uint32_t queue_len;          /*!< Number of commands that can be pending (power of 2) */
+    uint32_t refresh_period_ms;  /*!< Longest time pending commands wait before a refresh */
+    uint32_t task_stack_size;    /*!< Stack size of the render task */
+    UBaseType_t task_priority;   /*!< Priority of the render task */
+} led_render_config_t;
+
+/**
+ * @brief Default configuration for the render service
+ *
+ */
+#define LED_RENDER_DEFAULT_CONFIG(strip_hdl, number) \
+    {                                                \
+        .strip = strip_hdl,                          \
+        .led_num = number,                           \
+        .queue_len = 32,                             \
+        .refresh_period_ms = 20,                     \
+        .task_stack_size = 2048,                     \
+        .task_priority = tskIDLE_PRIORITY + 2,       \
+    }
+
+/**
+* @brief Start the render service
+*
+* @param config: render service configuration
+* @param ret_render: returned render service handle
+*
+* @return
+*      - ESP_OK: Render service started successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_NO_MEM: Out of memory
+*/
+esp_err_t led_render_start(const led_render_config_t *config, led_render_t **ret_render);
+
+/**
+* @brief Stop the render service
+*
+* @note The render task exits after applying the commands posted before this
+*       call. The handle must not be used afterwards. The strip is not deleted.
+*
+* @param render: render service
+*
+* @return
+*      - ESP_OK: Stop requested successfully
+*      - ESP_ERR_NO_MEM: Command queue full, try again later
+*/
+esp_err_t led_render_stop(led_render_t *render);
+
+/**
+* @brief Post a command that sets the color of a pixel
+*
+* @param render: render service
+* @param index: index of pixel to set
+* @param red: red part of color
+* @param green: green part of color
+* @param blue: blue part of color
+*
+* @return
+*      - ESP_OK: Command posted successfully
+*      - ESP_ERR_INVALID_ARG: Index out of the strip
+*      - ESP_ERR_NO_MEM: Command queue full, the command was dropped
+*/
+esp_err_t led_render_set_pixel(led_render_t *render, uint32_t index, uint8_t red, uint8_t green, uint8_t blue);
+
+/**
+* @brief Post a command that sets the color of a range of pixels
+*
+* @param render: render service
+* @param start: index of the first pixel to set
+* @param count: number of pixels to set
+* @param red: red part of color
+* @param green: green part of color
+* @param blue: blue part of color
+*
+* @return
+*      - ESP_OK: Command posted successfully
+*      - ESP_ERR_INVALID_ARG: Range out of the strip
+*      - ESP_ERR_NO_MEM: Command queue full, the command was dropped
+*/
+esp_err_t led_render_fill(led_render_t *render, uint32_t start, uint32_t count,
+                          uint8_t red, uint8_t green, uint8_t blue);
+
+/**
+* @brief Post a command that blanks (turns off) or unblanks the strip
+*
+* @note While the strip is blanked the pixels can still be changed: they are
+*       shown as soon as the strip is unblanked, without redrawing them.
+*
+* @param render: render service
+* @param blank: true to turn the LEDs off, false to show the pixels again
+*
+* @return
+*      - ESP_OK: Command posted successfully
+*      - ESP_ERR_NO_MEM: Command queue full, the command was dropped
+*/
+esp_err_t led_render_blank(led_render_t *render, bool blank);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,207 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "led_render.h"
+
+static const char *TAG = "led_render";
+#define RENDER_CHECK(a, str, goto_tag, ret_value, ...)                            \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+typedef enum {
+    LED_RENDER_CMD_FILL, // set_pixel is a fill of one pixel
+    LED_RENDER_CMD_BLANK,
+    LED_RENDER_CMD_STOP,
+} led_render_cmd_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint32_t start;
+    uint32_t count; // for LED_RENDER_CMD_BLANK: whether to blank
+} led_render_cmd_t;
+
+// Cell of the command queue. seq tells who owns the cell: see led_render_post()
+typedef struct {
+    atomic_uint seq;
+    led_render_cmd_t cmd;
+} led_render_cell_t;
+
+struct led_render_s {
+    led_strip_t *strip;
+    uint32_t led_num;
+    uint32_t refresh_period_ms;
+    TaskHandle_t task;
+    // Bounded multi-producer/single-consumer queue (Vyukov style)
+    uint32_t mask;
+    atomic_uint tail; // next position producers will claim
+    unsigned head;    // next position the render task will read, owned by it
+    led_render_cell_t cells[0];
+};
+
+static esp_err_t led_render_post(led_render_t *render, const led_render_cmd_t *cmd)
+{
+    // Producers claim a position by moving tail forward with a CAS. The cell at
+    // that position is free when its seq equals the position: the consumer sets
+    // it so after reading the previous command that lived there.
+    unsigned pos = atomic_load_explicit(&render->tail, memory_order_relaxed);
+    led_render_cell_t *cell;
+    while (1) {
+        cell = &render->cells[pos & render->mask];
+        unsigned seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&render->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+            // Someone else claimed it, pos has been updated: retry
+        } else if (diff < 0) {
+            // The consumer hasn't freed the cell yet: queue full
+            return ESP_ERR_NO_MEM;
+        } else {
+            pos = atomic_load_explicit(&render->tail, memory_order_relaxed);
+        }
+    }
+    cell->cmd = *cmd;
+    // Publish the command to the consumer
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    xTaskNotifyGive(render->task);
+    return ESP_OK;
+}
+
+static bool led_render_take(led_render_t *render, led_render_cmd_t *cmd)
+{
+    led_render_cell_t *cell = &render->cells[render->head & render->mask];
+    unsigned seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    if ((int)(seq - (render->head + 1)) < 0) {
+        // Empty, or a producer has claimed the cell but not written it yet
+        return false;
+    }
+    *cmd = cell->cmd;
+    // Hand the cell back to the producers, for the next round of the ring
+    atomic_store_explicit(&cell->seq, render->head + render->mask + 1, memory_order_release);
+    render->head++;
+    return true;
+}
+
+static void led_render_task(void *arg)
+{
+    led_render_t *render = arg;
+    bool stop = false;
+    while (!stop) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(render->refresh_period_ms));
+
+        // Apply everything posted so far in one batch, but no more than one
+        // queue worth of commands, so that a flood doesn't starve the refresh.
+        bool dirty = false;
+        led_render_cmd_t cmd;
+        for (uint32_t i = 0; i <= render->mask && led_render_take(render, &cmd); i++) {
+            switch (cmd.type) {
+            case LED_RENDER_CMD_FILL:
+                for (uint32_t j = cmd.start; j < cmd.start + cmd.count; j++) {
+                    led_strip_set_pixel(render->strip, j, cmd.red, cmd.green, cmd.blue);
+                }
+                dirty = true;
+                break;
+            case LED_RENDER_CMD_BLANK:
+                // Blackout keeps the strip buffer, so unblanking needs no redraw.
+                // It also refreshes the strip, including the pixels set so far.
+                led_strip_blackout(render->strip, cmd.count, 100);
+                dirty = false;
+                break;
+            case LED_RENDER_CMD_STOP:
+                stop = true;
+                break;
+            }
+        }
+        if (!dirty) {
+            continue;
+        }
+        esp_err_t ret = led_strip_refresh(render->strip, 100);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "refresh failed: %s", esp_err_to_name(ret));
+        }
+    }
+    free(render);
+    vTaskDelete(NULL);
+}
+
+esp_err_t led_render_start(const led_render_config_t *config, led_render_t **ret_render)
+{
+    esp_err_t ret = ESP_OK;
+    led_render_t *render = NULL;
+    RENDER_CHECK(config && config->strip && ret_render, "arguments can't be null", err, ESP_ERR_INVALID_ARG);
+    RENDER_CHECK(config->queue_len && !(config->queue_len & (config->queue_len - 1)),
+                 "queue length must be a power of 2", err, ESP_ERR_INVALID_ARG);
+
+    render = calloc(1, sizeof(led_render_t) + config->queue_len * sizeof(led_render_cell_t));
+    RENDER_CHECK(render, "request memory for render service failed", err, ESP_ERR_NO_MEM);
+    render->strip = config->strip;
+    render->led_num = config->led_num;
+    render->refresh_period_ms = config->refresh_period_ms;
+    render->mask = config->queue_len - 1;
+    for (uint32_t i = 0; i < config->queue_len; i++) {
+        atomic_init(&render->cells[i].seq, i);
+    }
+    atomic_init(&render->tail, 0);
+
+    RENDER_CHECK(xTaskCreate(led_render_task, "led_render", config->task_stack_size, render,
+                             config->task_priority, &render->task) == pdPASS,
+                 "create render task failed", err, ESP_ERR_NO_MEM);
+    *ret_render = render;
+    return ESP_OK;
+err:
+    free(render);
+    return ret;
+}
+
+esp_err_t led_render_stop(led_render_t *render)
+{
+    led_render_cmd_t cmd = { .type = LED_RENDER_CMD_STOP };
+    return led_render_post(render, &cmd);
+}
+
+esp_err_t led_render_set_pixel(led_render_t *render, uint32_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    return led_render_fill(render, index, 1, red, green, blue);
+}
+
+esp_err_t led_render_fill(led_render_t *render, uint32_t start, uint32_t count,
+                          uint8_t red, uint8_t green, uint8_t blue)
+{
+    esp_err_t ret = ESP_OK;
+    RENDER_CHECK(start < render->led_num && count <= render->led_num - start, "range out of the strip", err,
+                 ESP_ERR_INVALID_ARG);
+    led_render_cmd_t cmd = {
+        .type = LED_RENDER_CMD_FILL,
+        .red = red,
+        .green = green,
+        .blue = blue,
+        .start = start,
+        .count = count,
+    };
+    return led_render_post(render, &cmd);
+err:
+    return ret;
+}
+
+esp_err_t led_render_blank(led_render_t *render, bool blank)
+{
+    led_render_cmd_t cmd = {
+        .type = LED_RENDER_CMD_BLANK,
+        .count = blank,
+    };
+    return led_render_post(render, &cmd);
+}
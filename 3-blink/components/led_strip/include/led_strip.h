@@ -17,7 +17,11 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include "esp_err.h"
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
 
 /**
 * @brief LED Strip Type
@@ -93,23 +97,63 @@ struct led_strip_s {
     esp_err_t (*del)(led_strip_t *strip);
 };
 
+/**
+* @brief Layout of the pixel buffer
+*
+*/
+typedef enum {
+    LED_STRIP_LAYOUT_GRB,    /*!< Interleaved G,R,B bytes per pixel, as sent on the wire */
+    LED_STRIP_LAYOUT_PLANAR, /*!< Separate R, G and B arrays, interleaved while encoding */
+} led_strip_layout_t;
+
+/**
+* @brief Bit timing profiles
+*
+* @note The time needed to refresh a strip is 24 bits per LED times the bit
+*       time, so a shorter bit time is a direct frame rate gain on long strips.
+*/
+typedef enum {
+    LED_STRIP_TIMING_DEFAULT, /*!< 1.35 us per bit, very conservative */
+    LED_STRIP_TIMING_NOMINAL, /*!< 1.25 us per bit, nominal WS2812B timing */
+    LED_STRIP_TIMING_FAST,    /*!< 1.0 us per bit, at the edge of the WS2812B tolerances: check it with your LEDs */
+    LED_STRIP_TIMING_CUSTOM,  /*!< Use led_strip_config_t::custom_timing */
+} led_strip_timing_profile_t;
+
+/**
+* @brief Bit timing, i.e. duration of the high and low levels of bits 0 and 1
+*
+*/
+typedef struct {
+    uint16_t t0h_ns; /*!< High time of a 0 bit */
+    uint16_t t0l_ns; /*!< Low time of a 0 bit */
+    uint16_t t1h_ns; /*!< High time of a 1 bit */
+    uint16_t t1l_ns; /*!< Low time of a 1 bit */
+} led_strip_timing_t;
+
 /**
 * @brief LED Strip Configuration Type
 *
 */
 typedef struct {
-    uint32_t max_leds;   /*!< Maximum LEDs in a single strip */
-    led_strip_dev_t dev; /*!< LED strip device (e.g. RMT channel, PWM channel, etc) */
+    uint32_t max_leds;                         /*!< Maximum LEDs in a single strip */
+    led_strip_dev_t dev;                       /*!< LED strip device (e.g. RMT channel, PWM channel, etc) */
+    led_strip_layout_t layout;                 /*!< Layout of the pixel buffer */
+    led_strip_timing_profile_t timing_profile; /*!< Bit timing profile */
+    led_strip_timing_t custom_timing;          /*!< Bit timing, used with LED_STRIP_TIMING_CUSTOM only */
+    uint32_t reset_us;                         /*!< Low time that latches a frame, 0 for the default (280 us) */
 } led_strip_config_t;
 
 /**
  * @brief Default configuration for LED strip
  *
  */
-#define LED_STRIP_DEFAULT_CONFIG(number, dev_hdl) \
-    {                                             \
-        .max_leds = number,                       \
-        .dev = dev_hdl,                           \
+#define LED_STRIP_DEFAULT_CONFIG(number, dev_hdl)   \
+    {                                               \
+        .max_leds = number,                         \
+        .dev = dev_hdl,                             \
+        .layout = LED_STRIP_LAYOUT_GRB,             \
+        .timing_profile = LED_STRIP_TIMING_DEFAULT, \
+        .reset_us = 0,                              \
     }
 
 /**
@@ -121,6 +165,96 @@ typedef struct {
 */
 led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config);
 
+/**
+* @brief Pack a color in the format returned by led_strip_shader_t
+*
+*/
+#define LED_STRIP_GRB(red, green, blue) \
+    ((((uint32_t)(green) & 0xFF) << 16) | (((uint32_t)(red) & 0xFF) << 8) | ((uint32_t)(blue) & 0xFF))
+
+/**
+* @brief Pixel shader: generates the color of a pixel
+*
+* @param index: index of the pixel
+* @param frame: number of refreshes of the strip so far
+* @param arg: user argument given to led_strip_new_rmt_ws2812_shader()
+*
+* @return
+*      Color of the pixel, packed with LED_STRIP_GRB()
+*
+* @note The shader is called by the RMT translator while it encodes the
+*       frame, i.e. partly from the RMT interrupt handler: it must be fast,
+*       must not block and, if the RMT ISR is placed in IRAM, must be in IRAM.
+*/
+typedef uint32_t (*led_strip_shader_t)(uint32_t index, uint32_t frame, void *arg);
+
+/**
+* @brief Install a new ws2812 driver without pixel buffer, whose colors are generated by a shader
+*
+* The memory used by the strip doesn't depend on the number of LEDs: on each
+* refresh the shader is called once per pixel, in chunks, while the frame is
+* being encoded. set_pixel() returns ESP_ERR_NOT_SUPPORTED, clear() sends a
+* black frame.
+*
+* @param config: LED strip configuration
+* @param shader: pixel shader
+* @param arg: user argument passed to the shader
+* @return
+*      LED strip instance or NULL
+*/
+led_strip_t *led_strip_new_rmt_ws2812_shader(const led_strip_config_t *config, led_strip_shader_t shader, void *arg);
+
+/**
+* @brief Functions installed by the ws2812 driver in led_strip_t
+*
+* @note Prefer led_strip_set_pixel(), led_strip_refresh() and led_strip_clear(),
+*       which call these directly when CONFIG_LED_STRIP_DISPATCH_STATIC_WS2812 is set.
+*/
+esp_err_t led_strip_rmt_ws2812_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green,
+        uint32_t blue);
+esp_err_t led_strip_rmt_ws2812_refresh(led_strip_t *strip, uint32_t timeout_ms);
+esp_err_t led_strip_rmt_ws2812_clear(led_strip_t *strip, uint32_t timeout_ms);
+
+/**
+* @brief Set RGB for a specific pixel, same as strip->set_pixel()
+*
+*/
+static inline esp_err_t led_strip_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green,
+        uint32_t blue)
+{
+#if CONFIG_LED_STRIP_DISPATCH_STATIC_WS2812
+    return led_strip_rmt_ws2812_set_pixel(strip, index, red, green, blue);
+#else
+    return strip->set_pixel(strip, index, red, green, blue);
+#endif
+}
+
+/**
+* @brief Refresh memory colors to LEDs, same as strip->refresh()
+*
+*/
+static inline esp_err_t led_strip_refresh(led_strip_t *strip, uint32_t timeout_ms)
+{
+#if CONFIG_LED_STRIP_DISPATCH_STATIC_WS2812
+    return led_strip_rmt_ws2812_refresh(strip, timeout_ms);
+#else
+    return strip->refresh(strip, timeout_ms);
+#endif
+}
+
+/**
+* @brief Clear LED strip, same as strip->clear()
+*
+*/
+static inline esp_err_t led_strip_clear(led_strip_t *strip, uint32_t timeout_ms)
+{
+#if CONFIG_LED_STRIP_DISPATCH_STATIC_WS2812
+    return led_strip_rmt_ws2812_clear(strip, timeout_ms);
+#else
+    return strip->clear(strip, timeout_ms);
+#endif
+}
+
 /**
  * @brief Init the RMT peripheral and LED strip configuration.
  *
@@ -132,6 +266,64 @@ led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config);
  */
 led_strip_t * led_strip_init(uint8_t channel, uint8_t gpio, uint16_t led_num);
 
+/**
+ * @brief Turn all the LEDs off (or back on) without touching the pixel buffer
+ *
+ * Unlike clear(), the pixel buffer is preserved: while the strip is blacked out
+ * the translator emits zeros without reading the buffer, and every refresh()
+ * keeps the LEDs off. Leaving the blackout shows the buffer again with a single
+ * refresh, so there's no need to redraw the pixels (e.g. in the off phase of a blink).
+ *
+ * @param[in] strip: LED strip
+ * @param[in] blackout: true to turn the LEDs off, false to show the pixel buffer again
+ * @param[in] timeout_ms: timeout value for refreshing task
+ * @return
+ *      - ESP_OK: Blackout set successfully
+ *      - ESP_ERR_INVALID_ARG: Blackout failed because of invalid parameters
+ *      - ESP_ERR_TIMEOUT: Blackout failed because of timeout
+ *      - ESP_FAIL: Blackout failed because some other error occurred
+ */
+esp_err_t led_strip_blackout(led_strip_t *strip, bool blackout, uint32_t timeout_ms);
+
+/**
+ * @brief Get the channel planes of a strip created with LED_STRIP_LAYOUT_PLANAR
+ *
+ * Each plane is a contiguous array of `len` bytes (one per LED) that can be
+ * modified directly, e.g. with the helpers in led_strip_planar.h.
+ * The changes are sent to the LEDs by the next refresh.
+ *
+ * @param[in] strip: LED strip
+ * @param[out] red: red plane
+ * @param[out] green: green plane
+ * @param[out] blue: blue plane
+ * @param[out] len: number of LEDs, i.e. length of each plane
+ * @return
+ *      - ESP_OK: Get planes successfully
+ *      - ESP_ERR_INVALID_ARG: Get planes failed because of invalid parameters
+ *      - ESP_ERR_INVALID_STATE: Get planes failed because the strip doesn't use the planar layout
+ */
+esp_err_t led_strip_get_planes(led_strip_t *strip, uint8_t **red, uint8_t **green, uint8_t **blue, uint32_t *len);
+
+/**
+ * @brief Refresh the LEDs with an external GRB frame instead of the strip buffer.
+ *
+ * The frame is handed as-is to the RMT translator, so it can live anywhere the
+ * CPU can read from (e.g. a memory-mapped flash partition) and it is never
+ * copied into the strip buffer. The pixel buffer of the strip is left untouched.
+ * While the strip is blacked out (see led_strip_blackout()) the LEDs stay off.
+ *
+ * @param[in] strip: LED strip
+ * @param[in] grb: packed GRB frame, 3 bytes per LED
+ * @param[in] led_num: number of LEDs in the frame (the LEDs after them keep their colors)
+ * @param[in] timeout_ms: timeout value for refreshing task
+ * @return
+ *      - ESP_OK: Refresh successfully
+ *      - ESP_ERR_INVALID_ARG: Refresh failed because of invalid parameters
+ *      - ESP_ERR_TIMEOUT: Refresh failed because of timeout
+ *      - ESP_FAIL: Refresh failed because some other error occurred
+ */
+esp_err_t led_strip_refresh_grb(led_strip_t *strip, const uint8_t *grb, uint32_t led_num, uint32_t timeout_ms);
+
 /**
  * @brief Denit the RMT peripheral.
  *
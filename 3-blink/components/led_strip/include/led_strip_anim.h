@@ -0,0 +1,140 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "led_strip.h"
+
+/**
+* @brief Magic number at the beginning of an animation image ("LSA1", little endian)
+*
+*/
+#define LED_STRIP_ANIM_MAGIC (0x3141534CU)
+
+/**
+* @brief Header of an animation image
+*
+* @note The image is the header followed by `frame_num` frames. Each frame
+*       starts `frame_stride` bytes after the previous one and holds `led_num`
+*       packed GRB pixels (3 bytes per LED), i.e. exactly what the WS2812 expects
+*       on the wire. All fields are little endian.
+*/
+typedef struct {
+    uint32_t magic;           /*!< Must be LED_STRIP_ANIM_MAGIC */
+    uint16_t version;         /*!< Format version, currently 1 */
+    uint16_t header_size;     /*!< Offset of the first frame from the start of the image */
+    uint32_t led_num;         /*!< Number of LEDs in each frame */
+    uint32_t frame_num;       /*!< Number of frames in the image */
+    uint32_t frame_period_us; /*!< Time each frame stays on the strip */
+    uint32_t frame_stride;    /*!< Distance in bytes between two consecutive frames (>= led_num * 3) */
+} led_strip_anim_header_t;
+
+/**
+* @brief Animation Type
+*
+*/
+typedef struct led_strip_anim_s led_strip_anim_t;
+
+#ifdef ESP_PLATFORM
+/**
+* @brief Memory-map an animation stored in a data partition
+*
+* @param label: label of the partition in the partition table
+* @param ret_anim: returned animation handle
+*
+* @return
+*      - ESP_OK: Animation mapped successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_NOT_FOUND: No partition with such label
+*      - ESP_ERR_INVALID_VERSION: The partition doesn't contain a valid animation image
+*      - ESP_ERR_NO_MEM: Out of memory
+*/
+esp_err_t led_strip_anim_open_partition(const char *label, led_strip_anim_t **ret_anim);
+#else
+/**
+* @brief Memory-map an animation stored in a file (host builds only)
+*
+* @param path: path of the animation image
+* @param ret_anim: returned animation handle
+*
+* @return
+*      - ESP_OK: Animation mapped successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_NOT_FOUND: The file can't be opened or mapped
+*      - ESP_ERR_INVALID_VERSION: The file doesn't contain a valid animation image
+*      - ESP_ERR_NO_MEM: Out of memory
+*/
+esp_err_t led_strip_anim_open_file(const char *path, led_strip_anim_t **ret_anim);
+#endif
+
+/**
+* @brief Unmap the animation and free its resources
+*
+* @param anim: animation handle
+*
+* @return
+*      - ESP_OK: Animation closed successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*/
+esp_err_t led_strip_anim_close(led_strip_anim_t *anim);
+
+/**
+* @brief Get the (already validated) header of the animation
+*
+* @param anim: animation handle
+*
+* @return
+*      Pointer to the header, inside the mapped image
+*/
+const led_strip_anim_header_t *led_strip_anim_get_header(const led_strip_anim_t *anim);
+
+/**
+* @brief Get a pointer to a frame, inside the mapped image
+*
+* @param anim: animation handle
+* @param frame: index of the frame
+*
+* @return
+*      Pointer to the packed GRB pixels of the frame, or NULL if out of range
+*/
+const uint8_t *led_strip_anim_get_frame(const led_strip_anim_t *anim, uint32_t frame);
+
+/**
+* @brief Frame clock: index of the frame to be shown after some time from the start
+*
+* @param anim: animation handle
+* @param elapsed_us: time elapsed since the beginning of the playback
+*
+* @return
+*      Index of the frame (wraps around at the end of the animation)
+*/
+uint32_t led_strip_anim_frame_at(const led_strip_anim_t *anim, int64_t elapsed_us);
+
+#ifdef ESP_PLATFORM
+/**
+* @brief Play the animation on the strip
+*
+* Frames are sent to the strip straight from the mapped image (see led_strip_refresh_grb()).
+* The frame to show is picked by the frame clock, so if refreshing the strip
+* takes longer than a frame period, frames are skipped instead of slowing down
+* the whole animation.
+*
+* @param anim: animation handle
+* @param strip: LED strip (at least `led_num` LEDs long)
+* @param loops: number of times the animation is played, 0 means forever
+*
+* @return
+*      - ESP_OK: Animation played successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_TIMEOUT: Refreshing the strip timed out
+*      - ESP_FAIL: Refreshing the strip failed because some other error occurred
+*/
+esp_err_t led_strip_anim_play(led_strip_anim_t *anim, led_strip_t *strip, uint32_t loops);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "led_strip.h"
+
+/**
+* @brief Compositor Type
+*
+* @note The compositor holds a stack of layers on top of a LED strip. Each layer
+*       has a color and an alpha (0 = transparent, 255 = opaque) per pixel.
+*       Layer 0 is the bottom one. Each layer tracks the range of pixels that
+*       changed since the last refresh, and only those ranges are blended again
+*       into the strip: a layer that doesn't change costs nothing.
+*/
+typedef struct led_strip_compositor_s led_strip_compositor_t;
+
+/**
+* @brief Create a compositor
+*
+* @param strip: LED strip the layers are blended into
+* @param led_num: number of LEDs of the strip
+* @param layer_num: number of layers
+*
+* @return
+*      Compositor instance or NULL
+*/
+led_strip_compositor_t *led_strip_compositor_new(led_strip_t *strip, uint32_t led_num, uint32_t layer_num);
+
+/**
+* @brief Free the compositor (the strip is not deleted)
+*
+* @param comp: compositor
+*
+* @return
+*      - ESP_OK: Free resources successfully
+*/
+esp_err_t led_strip_compositor_del(led_strip_compositor_t *comp);
+
+/**
+* @brief Set color and alpha of a pixel of a layer
+*
+* @param comp: compositor
+* @param layer: index of the layer
+* @param index: index of the pixel
+* @param red: red part of color
+* @param green: green part of color
+* @param blue: blue part of color
+* @param alpha: 0 (transparent, i.e. masked out) to 255 (opaque)
+*
+* @return
+*      - ESP_OK: Set pixel successfully
+*      - ESP_ERR_INVALID_ARG: Layer or pixel out of range
+*/
+esp_err_t led_strip_layer_set_pixel(led_strip_compositor_t *comp, uint32_t layer, uint32_t index,
+                                    uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha);
+
+/**
+* @brief Set color and alpha of a range of pixels of a layer
+*
+* @param comp: compositor
+* @param layer: index of the layer
+* @param start: index of the first pixel
+* @param count: number of pixels
+* @param red: red part of color
+* @param green: green part of color
+* @param blue: blue part of color
+* @param alpha: 0 (transparent, i.e. masked out) to 255 (opaque)
+*
+* @return
+*      - ESP_OK: Fill successfully
+*      - ESP_ERR_INVALID_ARG: Layer or range out of range
+*/
+esp_err_t led_strip_layer_fill(led_strip_compositor_t *comp, uint32_t layer, uint32_t start, uint32_t count,
+                               uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha);
+
+/**
+* @brief Show or hide a whole layer
+*
+* @param comp: compositor
+* @param layer: index of the layer
+* @param visible: whether the layer is blended
+*
+* @return
+*      - ESP_OK: Set visibility successfully
+*      - ESP_ERR_INVALID_ARG: Layer out of range
+*/
+esp_err_t led_strip_layer_set_visible(led_strip_compositor_t *comp, uint32_t layer, bool visible);
+
+/**
+* @brief Blend the changed pixel ranges into the strip and refresh it
+*
+* @note If nothing changed since the last refresh the strip is not refreshed at all.
+*
+* @param comp: compositor
+* @param timeout_ms: timeout value for refreshing task
+*
+* @return
+*      - ESP_OK: Refresh successfully
+*      - ESP_ERR_TIMEOUT: Refresh failed because of timeout
+*      - ESP_FAIL: Refresh failed because some other error occurred
+*/
+esp_err_t led_strip_compositor_refresh(led_strip_compositor_t *comp, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+* @brief Channel-wise operations on the planes of a LED_STRIP_LAYOUT_PLANAR strip
+*
+* @note Each plane is a contiguous array with one byte per LED (see led_strip_get_planes()),
+*       so these are plain loops over contiguous memory that the compiler can vectorise.
+*/
+
+/**
+* @brief Set all the values of a plane
+*
+* @param plane: channel plane
+* @param len: number of LEDs
+* @param value: new value
+*/
+void led_strip_plane_fill(uint8_t *plane, uint32_t len, uint8_t value);
+
+/**
+* @brief Scale all the values of a plane, e.g. to dim a channel
+*
+* @param plane: channel plane
+* @param len: number of LEDs
+* @param scale: 0 turns the channel off, 255 leaves it unchanged
+*/
+void led_strip_plane_scale(uint8_t *plane, uint32_t len, uint8_t scale);
+
+/**
+* @brief Add a constant to all the values of a plane, saturating at 255
+*
+* @param plane: channel plane
+* @param len: number of LEDs
+* @param value: value to add
+*/
+void led_strip_plane_add_value(uint8_t *plane, uint32_t len, uint8_t value);
+
+/**
+* @brief Add another plane element-wise, saturating at 255
+*
+* @param dst: channel plane, updated in place
+* @param src: plane to add, must not overlap dst
+* @param len: number of LEDs
+*/
+void led_strip_plane_add(uint8_t *dst, const uint8_t *src, uint32_t len);
+
+/**
+* @brief Subtract another plane element-wise, saturating at 0
+*
+* @param dst: channel plane, updated in place
+* @param src: plane to subtract, must not overlap dst
+* @param len: number of LEDs
+*/
+void led_strip_plane_sub(uint8_t *dst, const uint8_t *src, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "led_strip.h"
+
+/**
+* @brief Maximum length of a scene name, including the terminator
+*
+*/
+#define LED_STRIP_SCENE_NAME_LEN (16)
+
+/**
+* @brief Scene cache Type
+*
+* @note The scene cache keeps fully encoded RMT frames of a ws2812 strip for a
+*       few named presets. Showing a cached scene sends the stored items as
+*       they are: no set_pixel and no encoding at all. Each scene takes 96
+*       bytes per LED (24 RMT items of 4 bytes); when the memory budget of the
+*       cache is exceeded, the least recently used scenes are evicted.
+*/
+typedef struct led_strip_scene_cache_s led_strip_scene_cache_t;
+
+/**
+* @brief Create a scene cache
+*
+* @param strip: ws2812 LED strip
+* @param max_bytes: memory budget for the encoded scenes
+*
+* @return
+*      Scene cache instance or NULL
+*/
+led_strip_scene_cache_t *led_strip_scene_cache_new(led_strip_t *strip, size_t max_bytes);
+
+/**
+* @brief Free the scene cache and all the cached scenes (the strip is not deleted)
+*
+* @param cache: scene cache
+*
+* @return
+*      - ESP_OK: Free resources successfully
+*/
+esp_err_t led_strip_scene_cache_del(led_strip_scene_cache_t *cache);
+
+/**
+* @brief Encode the current content of the strip and cache it as a scene
+*
+* @note An existing scene with the same name is replaced.
+*
+* @param cache: scene cache
+* @param name: name of the scene
+*
+* @return
+*      - ESP_OK: Scene stored successfully
+*      - ESP_ERR_INVALID_ARG: Name too long
+*      - ESP_ERR_NO_MEM: The scene doesn't fit in the memory budget, or out of memory
+*/
+esp_err_t led_strip_scene_store(led_strip_scene_cache_t *cache, const char *name);
+
+/**
+* @brief Send a cached scene to the strip
+*
+* @note The pixel buffer of the strip is not changed.
+*
+* @param cache: scene cache
+* @param name: name of the scene
+* @param timeout_ms: timeout value for refreshing task
+*
+* @return
+*      - ESP_OK: Scene shown successfully
+*      - ESP_ERR_NOT_FOUND: No such scene in the cache (never stored, or evicted)
+*      - ESP_ERR_TIMEOUT: Refresh failed because of timeout
+*      - ESP_FAIL: Refresh failed because some other error occurred
+*/
+esp_err_t led_strip_scene_show(led_strip_scene_cache_t *cache, const char *name, uint32_t timeout_ms);
+
+/**
+* @brief Remove a scene from the cache
+*
+* @param cache: scene cache
+* @param name: name of the scene
+*
+* @return
+*      - ESP_OK: Scene removed successfully
+*      - ESP_ERR_NOT_FOUND: No such scene in the cache
+*/
+esp_err_t led_strip_scene_forget(led_strip_scene_cache_t *cache, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
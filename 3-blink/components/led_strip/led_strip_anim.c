@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "led_strip_anim.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char *TAG = "led_strip_anim";
+#define ANIM_CHECK(a, str, goto_tag, ret_value, ...)                              \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+#define LED_STRIP_ANIM_VERSION (1)
+
+struct led_strip_anim_s {
+    const uint8_t *image; // start of the mapped image
+    size_t image_size;
+#ifdef ESP_PLATFORM
+    spi_flash_mmap_handle_t mmap_handle;
+#endif
+};
+
+static esp_err_t led_strip_anim_validate(const uint8_t *image, size_t image_size)
+{
+    esp_err_t ret = ESP_OK;
+    ANIM_CHECK(image_size >= sizeof(led_strip_anim_header_t), "image too small", err, ESP_ERR_INVALID_VERSION);
+    const led_strip_anim_header_t *header = (const led_strip_anim_header_t *)image;
+    ANIM_CHECK(header->magic == LED_STRIP_ANIM_MAGIC, "bad magic number 0x%08x", err, ESP_ERR_INVALID_VERSION,
+               (unsigned)header->magic);
+    ANIM_CHECK(header->version == LED_STRIP_ANIM_VERSION, "unsupported version %u", err, ESP_ERR_INVALID_VERSION,
+               (unsigned)header->version);
+    ANIM_CHECK(header->header_size >= sizeof(led_strip_anim_header_t), "bad header size", err, ESP_ERR_INVALID_VERSION);
+    ANIM_CHECK(header->led_num && header->frame_num && header->frame_period_us, "empty animation", err,
+               ESP_ERR_INVALID_VERSION);
+    ANIM_CHECK(header->frame_stride >= (uint64_t)header->led_num * 3, "frame stride too small", err,
+               ESP_ERR_INVALID_VERSION);
+    // 64 bits, so that a corrupted header can't make it wrap around
+    uint64_t needed = header->header_size + (uint64_t)header->frame_num * header->frame_stride;
+    ANIM_CHECK(needed <= image_size, "image truncated (%u frames don't fit)", err, ESP_ERR_INVALID_VERSION,
+               (unsigned)header->frame_num);
+    return ESP_OK;
+err:
+    return ret;
+}
+
+#ifdef ESP_PLATFORM
+esp_err_t led_strip_anim_open_partition(const char *label, led_strip_anim_t **ret_anim)
+{
+    esp_err_t ret = ESP_OK;
+    led_strip_anim_t *anim = NULL;
+    ANIM_CHECK(label && ret_anim, "label and ret_anim can't be null", err, ESP_ERR_INVALID_ARG);
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                       label);
+    ANIM_CHECK(partition, "partition %s not found", err, ESP_ERR_NOT_FOUND, label);
+    anim = calloc(1, sizeof(led_strip_anim_t));
+    ANIM_CHECK(anim, "request memory for animation failed", err, ESP_ERR_NO_MEM);
+
+    const void *image = NULL;
+    ret = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &image, &anim->mmap_handle);
+    ANIM_CHECK(ret == ESP_OK, "mmap partition %s failed", err, ret, label);
+    anim->image = image;
+    anim->image_size = partition->size;
+
+    ret = led_strip_anim_validate(anim->image, anim->image_size);
+    if (ret != ESP_OK) {
+        spi_flash_munmap(anim->mmap_handle);
+        goto err;
+    }
+    *ret_anim = anim;
+    return ESP_OK;
+err:
+    free(anim);
+    return ret;
+}
+#else
+esp_err_t led_strip_anim_open_file(const char *path, led_strip_anim_t **ret_anim)
+{
+    esp_err_t ret = ESP_OK;
+    led_strip_anim_t *anim = NULL;
+    int fd = -1;
+    ANIM_CHECK(path && ret_anim, "path and ret_anim can't be null", err, ESP_ERR_INVALID_ARG);
+    fd = open(path, O_RDONLY);
+    ANIM_CHECK(fd >= 0, "open %s failed", err, ESP_ERR_NOT_FOUND, path);
+    struct stat st;
+    ANIM_CHECK(fstat(fd, &st) == 0 && st.st_size > 0, "stat %s failed", err, ESP_ERR_NOT_FOUND, path);
+    anim = calloc(1, sizeof(led_strip_anim_t));
+    ANIM_CHECK(anim, "request memory for animation failed", err, ESP_ERR_NO_MEM);
+
+    void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ANIM_CHECK(image != MAP_FAILED, "mmap %s failed", err, ESP_ERR_NOT_FOUND, path);
+    // The mapping stays valid after the file descriptor is closed
+    close(fd);
+    fd = -1;
+    anim->image = image;
+    anim->image_size = st.st_size;
+
+    ret = led_strip_anim_validate(anim->image, anim->image_size);
+    if (ret != ESP_OK) {
+        munmap(image, anim->image_size);
+        goto err;
+    }
+    *ret_anim = anim;
+    return ESP_OK;
+err:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(anim);
+    return ret;
+}
+#endif
+
+esp_err_t led_strip_anim_close(led_strip_anim_t *anim)
+{
+    esp_err_t ret = ESP_OK;
+    ANIM_CHECK(anim, "animation can't be null", err, ESP_ERR_INVALID_ARG);
+#ifdef ESP_PLATFORM
+    spi_flash_munmap(anim->mmap_handle);
+#else
+    munmap((void *)anim->image, anim->image_size);
+#endif
+    free(anim);
+    return ESP_OK;
+err:
+    return ret;
+}
+
+const led_strip_anim_header_t *led_strip_anim_get_header(const led_strip_anim_t *anim)
+{
+    return (const led_strip_anim_header_t *)anim->image;
+}
+
+const uint8_t *led_strip_anim_get_frame(const led_strip_anim_t *anim, uint32_t frame)
+{
+    const led_strip_anim_header_t *header = led_strip_anim_get_header(anim);
+    if (frame >= header->frame_num) {
+        return NULL;
+    }
+    return anim->image + header->header_size + (size_t)frame * header->frame_stride;
+}
+
+uint32_t led_strip_anim_frame_at(const led_strip_anim_t *anim, int64_t elapsed_us)
+{
+    const led_strip_anim_header_t *header = led_strip_anim_get_header(anim);
+    if (elapsed_us < 0) {
+        return 0;
+    }
+    return (uint32_t)((elapsed_us / header->frame_period_us) % header->frame_num);
+}
+
+#ifdef ESP_PLATFORM
+esp_err_t led_strip_anim_play(led_strip_anim_t *anim, led_strip_t *strip, uint32_t loops)
+{
+    esp_err_t ret = ESP_OK;
+    ANIM_CHECK(anim && strip, "animation and strip can't be null", err, ESP_ERR_INVALID_ARG);
+    const led_strip_anim_header_t *header = led_strip_anim_get_header(anim);
+    const int64_t period_us = header->frame_period_us;
+    const int64_t duration_us = (int64_t)loops * header->frame_num * period_us;
+    // Refreshing must not take more than a couple of frames, otherwise something is wrong
+    const uint32_t timeout_ms = 2 * period_us / 1000 + 100;
+
+    const int64_t start_us = esp_timer_get_time();
+    int64_t shown_tick = -1;
+    while (1) {
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        if (loops && elapsed_us >= duration_us) {
+            break;
+        }
+        // Which frame is due is decided by the clock, not by counting refreshes:
+        // a late refresh skips frames rather than stretching the animation.
+        int64_t tick = elapsed_us / period_us;
+        if (tick != shown_tick) {
+            const uint8_t *frame = led_strip_anim_get_frame(anim, led_strip_anim_frame_at(anim, elapsed_us));
+            ret = led_strip_refresh_grb(strip, frame, header->led_num, timeout_ms);
+            ANIM_CHECK(ret == ESP_OK, "refresh frame %lld failed", err, ret, (long long)tick);
+            shown_tick = tick;
+        }
+        // Sleep until the next frame is due (at least one tick, so that lower priority tasks can run)
+        int64_t wait_us = (tick + 1) * period_us - (esp_timer_get_time() - start_us);
+        TickType_t wait_ticks = wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) : 0;
+        vTaskDelay(wait_ticks ? wait_ticks : 1);
+    }
+    return ESP_OK;
+err:
+    return ret;
+}
+#endif
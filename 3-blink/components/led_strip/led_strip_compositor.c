@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "led_strip_compositor.h"
+
+static const char *TAG = "led_strip_comp";
+#define COMP_CHECK(a, str, goto_tag, ret_value, ...)                              \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+typedef struct {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t alpha;
+} rgba_t;
+
+typedef struct {
+    rgba_t *pixels;
+    bool visible;
+    // Pixels [dirty_start, dirty_end) changed since the last refresh
+    uint32_t dirty_start;
+    uint32_t dirty_end;
+    // Pixels [used_start, used_end) have been drawn at least once: hiding or
+    // showing the layer can only change those
+    uint32_t used_start;
+    uint32_t used_end;
+} layer_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} range_t;
+
+struct led_strip_compositor_s {
+    led_strip_t *strip;
+    uint32_t led_num;
+    uint32_t layer_num;
+    range_t *ranges; // scratch space for the refresh, one per layer
+    layer_t layers[0];
+};
+
+static void layer_mark_dirty(layer_t *layer, uint32_t start, uint32_t end)
+{
+    if (start >= end) {
+        return;
+    }
+    if (layer->dirty_start >= layer->dirty_end) {
+        layer->dirty_start = start;
+        layer->dirty_end = end;
+    } else {
+        layer->dirty_start = start < layer->dirty_start ? start : layer->dirty_start;
+        layer->dirty_end = end > layer->dirty_end ? end : layer->dirty_end;
+    }
+}
+
+// x / 255, exact for any x in [0, 255 * 255]
+static inline uint8_t div255(uint32_t x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+static inline uint8_t blend(uint8_t below, uint8_t above, uint8_t alpha)
+{
+    return div255(above * alpha + below * (255 - alpha));
+}
+
+static void compose_range(led_strip_compositor_t *comp, uint32_t start, uint32_t end)
+{
+    for (uint32_t i = start; i < end; i++) {
+        // Everything below the topmost opaque pixel is hidden: start from there
+        int bottom = 0;
+        for (int l = comp->layer_num - 1; l >= 0; l--) {
+            if (comp->layers[l].visible && comp->layers[l].pixels[i].alpha == 255) {
+                bottom = l;
+                break;
+            }
+        }
+        uint8_t red = 0, green = 0, blue = 0;
+        for (uint32_t l = bottom; l < comp->layer_num; l++) {
+            const layer_t *layer = &comp->layers[l];
+            const rgba_t *p = &layer->pixels[i];
+            if (!layer->visible || p->alpha == 0) {
+                continue;
+            }
+            red = blend(red, p->red, p->alpha);
+            green = blend(green, p->green, p->alpha);
+            blue = blend(blue, p->blue, p->alpha);
+        }
+        led_strip_set_pixel(comp->strip, i, red, green, blue);
+    }
+}
+
+static int range_cmp(const void *a, const void *b)
+{
+    const range_t *ra = a, *rb = b;
+    return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+led_strip_compositor_t *led_strip_compositor_new(led_strip_t *strip, uint32_t led_num, uint32_t layer_num)
+{
+    led_strip_compositor_t *ret = NULL;
+    led_strip_compositor_t *comp = NULL;
+    COMP_CHECK(strip && led_num && layer_num, "invalid arguments", err, NULL);
+    comp = calloc(1, sizeof(led_strip_compositor_t) + layer_num * sizeof(layer_t));
+    COMP_CHECK(comp, "request memory for compositor failed", err, NULL);
+    comp->strip = strip;
+    comp->led_num = led_num;
+    comp->layer_num = layer_num;
+    comp->ranges = calloc(layer_num, sizeof(range_t));
+    COMP_CHECK(comp->ranges, "request memory for compositor failed", err, NULL);
+    for (uint32_t l = 0; l < layer_num; l++) {
+        // calloc: all transparent
+        comp->layers[l].pixels = calloc(led_num, sizeof(rgba_t));
+        COMP_CHECK(comp->layers[l].pixels, "request memory for layer %u failed", err, NULL, (unsigned)l);
+        comp->layers[l].visible = true;
+    }
+    // The strip content is unknown: the first refresh composes everything
+    layer_mark_dirty(&comp->layers[0], 0, led_num);
+    return comp;
+err:
+    if (comp) {
+        led_strip_compositor_del(comp);
+    }
+    return ret;
+}
+
+esp_err_t led_strip_compositor_del(led_strip_compositor_t *comp)
+{
+    for (uint32_t l = 0; l < comp->layer_num; l++) {
+        free(comp->layers[l].pixels);
+    }
+    free(comp->ranges);
+    free(comp);
+    return ESP_OK;
+}
+
+esp_err_t led_strip_layer_set_pixel(led_strip_compositor_t *comp, uint32_t layer, uint32_t index,
+                                    uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha)
+{
+    return led_strip_layer_fill(comp, layer, index, 1, red, green, blue, alpha);
+}
+
+esp_err_t led_strip_layer_fill(led_strip_compositor_t *comp, uint32_t layer, uint32_t start, uint32_t count,
+                               uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha)
+{
+    esp_err_t ret = ESP_OK;
+    COMP_CHECK(layer < comp->layer_num, "layer out of range", err, ESP_ERR_INVALID_ARG);
+    COMP_CHECK(start < comp->led_num && count <= comp->led_num - start, "pixels out of range", err,
+               ESP_ERR_INVALID_ARG);
+    layer_t *l = &comp->layers[layer];
+    const rgba_t color = { red, green, blue, alpha };
+    uint32_t changed_start = start + count, changed_end = start;
+    for (uint32_t i = start; i < start + count; i++) {
+        // Redrawing the same color (e.g. a static overlay drawn every frame) doesn't dirty anything
+        if (memcmp(&l->pixels[i], &color, sizeof(color)) != 0) {
+            l->pixels[i] = color;
+            changed_start = i < changed_start ? i : changed_start;
+            changed_end = i + 1;
+        }
+    }
+    if (changed_start >= changed_end) {
+        return ESP_OK;
+    }
+    if (l->visible) {
+        layer_mark_dirty(l, changed_start, changed_end);
+    }
+    if (l->used_start >= l->used_end) {
+        l->used_start = changed_start;
+        l->used_end = changed_end;
+    } else {
+        l->used_start = changed_start < l->used_start ? changed_start : l->used_start;
+        l->used_end = changed_end > l->used_end ? changed_end : l->used_end;
+    }
+    return ESP_OK;
+err:
+    return ret;
+}
+
+esp_err_t led_strip_layer_set_visible(led_strip_compositor_t *comp, uint32_t layer, bool visible)
+{
+    esp_err_t ret = ESP_OK;
+    COMP_CHECK(layer < comp->layer_num, "layer out of range", err, ESP_ERR_INVALID_ARG);
+    layer_t *l = &comp->layers[layer];
+    if (l->visible != visible) {
+        l->visible = visible;
+        layer_mark_dirty(l, l->used_start, l->used_end);
+    }
+    return ESP_OK;
+err:
+    return ret;
+}
+
+esp_err_t led_strip_compositor_refresh(led_strip_compositor_t *comp, uint32_t timeout_ms)
+{
+    // Collect the dirty ranges of all the layers...
+    uint32_t range_num = 0;
+    for (uint32_t l = 0; l < comp->layer_num; l++) {
+        layer_t *layer = &comp->layers[l];
+        if (layer->dirty_start < layer->dirty_end) {
+            comp->ranges[range_num].start = layer->dirty_start;
+            comp->ranges[range_num].end = layer->dirty_end;
+            range_num++;
+            layer->dirty_start = layer->dirty_end = 0;
+        }
+    }
+    if (range_num == 0) {
+        // Nothing changed: the strip already shows the right colors
+        return ESP_OK;
+    }
+    // ...merge the overlapping ones, so that no pixel is blended twice...
+    qsort(comp->ranges, range_num, sizeof(range_t), range_cmp);
+    range_t current = comp->ranges[0];
+    for (uint32_t r = 1; r < range_num; r++) {
+        if (comp->ranges[r].start <= current.end) {
+            current.end = comp->ranges[r].end > current.end ? comp->ranges[r].end : current.end;
+        } else {
+            compose_range(comp, current.start, current.end);
+            current = comp->ranges[r];
+        }
+    }
+    // ...and blend them into the strip
+    compose_range(comp, current.start, current.end);
+    return led_strip_refresh(comp->strip, timeout_ms);
+}
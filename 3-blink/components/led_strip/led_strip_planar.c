@@ -0,0 +1,43 @@
+#include <string.h>
+#include "led_strip_planar.h"
+
+// The loops below are kept branch-free on purpose, so that they get vectorised
+// wherever the target has SIMD instructions.
+
+void led_strip_plane_fill(uint8_t *plane, uint32_t len, uint8_t value)
+{
+    memset(plane, value, len);
+}
+
+void led_strip_plane_scale(uint8_t *plane, uint32_t len, uint8_t scale)
+{
+    // (x * (scale + 1)) >> 8 maps 255 to the identity without a division
+    const uint16_t factor = (uint16_t)scale + 1;
+    for (uint32_t i = 0; i < len; i++) {
+        plane[i] = (uint8_t)((plane[i] * factor) >> 8);
+    }
+}
+
+void led_strip_plane_add_value(uint8_t *plane, uint32_t len, uint8_t value)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        uint16_t sum = plane[i] + value;
+        plane[i] = sum > 0xFF ? 0xFF : (uint8_t)sum;
+    }
+}
+
+void led_strip_plane_add(uint8_t *restrict dst, const uint8_t *restrict src, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        uint16_t sum = dst[i] + src[i];
+        dst[i] = sum > 0xFF ? 0xFF : (uint8_t)sum;
+    }
+}
+
+void led_strip_plane_sub(uint8_t *restrict dst, const uint8_t *restrict src, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        int16_t diff = dst[i] - src[i];
+        dst[i] = diff < 0 ? 0 : (uint8_t)diff;
+    }
+}
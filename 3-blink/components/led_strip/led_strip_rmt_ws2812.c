@@ -11,12 +11,17 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/cdefs.h>
 #include "esp_log.h"
 #include "esp_attr.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
 #include "led_strip.h"
+#include "led_strip_rmt_ws2812_priv.h"
 #include "driver/rmt.h"
 
 #define RMT_TX_CHANNEL RMT_CHANNEL_0
@@ -33,24 +38,94 @@ static const char *TAG = "ws2812";
         }                                                                         \
     } while (0)
 
-#define WS2812_T0H_NS (350)
-#define WS2812_T0L_NS (1000)
-#define WS2812_T1H_NS (1000)
-#define WS2812_T1L_NS (350)
 #define WS2812_RESET_US (280)
 
-static uint32_t ws2812_t0h_ticks = 0;
-static uint32_t ws2812_t1h_ticks = 0;
-static uint32_t ws2812_t0l_ticks = 0;
-static uint32_t ws2812_t1l_ticks = 0;
+// Indexed by led_strip_timing_profile_t
+static const led_strip_timing_t ws2812_timings[] = {
+    // 1.35 us per bit: what this driver always used, very conservative
+    [LED_STRIP_TIMING_DEFAULT] = { .t0h_ns = 350, .t0l_ns = 1000, .t1h_ns = 1000, .t1l_ns = 350 },
+    // 1.25 us per bit: nominal values of the WS2812B datasheet
+    [LED_STRIP_TIMING_NOMINAL] = { .t0h_ns = 400, .t0l_ns = 850, .t1h_ns = 800, .t1l_ns = 450 },
+    // 1.0 us per bit: nominal values moved by 150 ns, the datasheet tolerance
+    [LED_STRIP_TIMING_FAST] = { .t0h_ns = 300, .t0l_ns = 700, .t1h_ns = 700, .t1l_ns = 300 },
+};
+
+typedef enum {
+    WS2812_SOURCE_GRB,    // interleaved GRB bytes, as sent on the wire
+    WS2812_SOURCE_PLANAR, // R, G and B planes of the strip buffer
+    WS2812_SOURCE_BLACK,  // constant zero, the source isn't read at all
+    WS2812_SOURCE_SHADER, // colors generated by the shader, the source isn't read at all
+} ws2812_source_t;
 
 typedef struct {
     led_strip_t parent;
     rmt_channel_t rmt_channel;
     uint32_t strip_len;
+    rmt_item32_t bit0;         // logical 0, in RMT ticks
+    rmt_item32_t bit1;         // logical 1, in RMT ticks
+    uint32_t reset_us;         // time the line must stay low to latch a frame
+    int64_t tx_done_us;        // when the last transmission ended...
+    bool tx_pending;           // ...unless it was still going when its wait timed out
+    led_strip_layout_t layout;
+    bool blackout;             // refresh sends black, leaving buffer untouched
+    ws2812_source_t tx_source; // what the translator is reading during the current transmission
+    const uint8_t *tx_base;    // first byte of the current transmission
+    led_strip_shader_t shader; // not NULL if the strip has no buffer and colors come from here
+    void *shader_arg;
+    uint32_t shader_frame;     // frame number passed to the shader, incremented by each refresh
+    uint32_t shader_pixel;     // last pixel generated by the shader...
+    uint32_t shader_grb;       // ...and its color, since a pixel may span two chunks
     uint8_t buffer[0];
 } ws2812_t;
 
+// Encode bytes of a transmission into RMT items. offset is the position of the
+// first byte within the transmission, base its first byte.
+static size_t IRAM_ATTR ws2812_encode(ws2812_t *ws2812, ws2812_source_t source, const uint8_t *base, size_t offset,
+                                      rmt_item32_t *dest, size_t src_size, size_t wanted_num, size_t *item_num)
+{
+    const rmt_item32_t bit0 = ws2812->bit0; //Logical 0
+    const rmt_item32_t bit1 = ws2812->bit1; //Logical 1
+    size_t size = 0;
+    size_t num = 0;
+    const uint8_t *psrc = base + offset;
+    rmt_item32_t *pdest = dest;
+    while (size < src_size && num < wanted_num) {
+        uint8_t byte;
+        if (source == WS2812_SOURCE_BLACK) {
+            byte = 0;
+        } else if (source == WS2812_SOURCE_SHADER) {
+            uint32_t pixel = offset / 3;
+            if (pixel != ws2812->shader_pixel) {
+                ws2812->shader_grb = ws2812->shader(pixel, ws2812->shader_frame, ws2812->shader_arg);
+                ws2812->shader_pixel = pixel;
+            }
+            byte = ws2812->shader_grb >> (16 - 8 * (offset % 3));
+        } else if (source == WS2812_SOURCE_PLANAR) {
+            // Interleave the planes on the fly: G, R, B for each pixel
+            static const uint8_t plane_of_channel[3] = { 1, 0, 2 };
+            uint32_t pixel = offset / 3;
+            byte = ws2812->buffer[plane_of_channel[offset % 3] * ws2812->strip_len + pixel];
+        } else {
+            byte = *psrc;
+        }
+        for (int i = 0; i < 8; i++) {
+            // MSB first
+            if (byte & (1 << (7 - i))) {
+                pdest->val =  bit1.val;
+            } else {
+                pdest->val =  bit0.val;
+            }
+            num++;
+            pdest++;
+        }
+        size++;
+        psrc++;
+        offset++;
+    }
+    *item_num = num;
+    return size;
+}
+
 /**
  * @brief Conver RGB data to RMT format.
  *
@@ -71,35 +146,69 @@ static void IRAM_ATTR ws2812_rmt_adapter(const void *src, rmt_item32_t *dest, si
         *item_num = 0;
         return;
     }
-    const rmt_item32_t bit0 = {{{ ws2812_t0h_ticks, 1, ws2812_t0l_ticks, 0 }}}; //Logical 0
-    const rmt_item32_t bit1 = {{{ ws2812_t1h_ticks, 1, ws2812_t1l_ticks, 0 }}}; //Logical 1
-    size_t size = 0;
-    size_t num = 0;
-    uint8_t *psrc = (uint8_t *)src;
-    rmt_item32_t *pdest = dest;
-    while (size < src_size && num < wanted_num) {
-        for (int i = 0; i < 8; i++) {
-            // MSB first
-            if (*psrc & (1 << (7 - i))) {
-                pdest->val =  bit1.val;
-            } else {
-                pdest->val =  bit0.val;
-            }
-            num++;
-            pdest++;
-        }
-        size++;
-        psrc++;
+    ws2812_t *ws2812 = NULL;
+    rmt_translator_get_context(item_num, (void **)&ws2812);
+    // Position of src within the transmission (the driver calls us once per chunk)
+    size_t offset = (const uint8_t *)src - ws2812->tx_base;
+    *translated_size = ws2812_encode(ws2812, ws2812->tx_source, ws2812->tx_base, offset, dest, src_size, wanted_num,
+                                     item_num);
+}
+
+static void ws2812_wait_reset(ws2812_t *ws2812)
+{
+    if (ws2812->tx_pending) {
+        // The translator may still be reading the previous transmission, and
+        // the reset time only starts at its end
+        rmt_wait_tx_done(ws2812->rmt_channel, portMAX_DELAY);
+        ws2812->tx_done_us = esp_timer_get_time();
+        ws2812->tx_pending = false;
+    }
+    // The LEDs latch the previous frame only after the line has been low for
+    // the reset time: starting earlier would append to it
+    int64_t idle_us = esp_timer_get_time() - ws2812->tx_done_us;
+    if (idle_us < ws2812->reset_us) {
+        esp_rom_delay_us(ws2812->reset_us - idle_us);
     }
-    *translated_size = size;
-    *item_num = num;
 }
 
-static esp_err_t ws2812_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+// Wait for the end of the transmission, and note when the line went idle
+static esp_err_t ws2812_wait_tx(ws2812_t *ws2812, uint32_t timeout_ms)
+{
+    esp_err_t ret = rmt_wait_tx_done(ws2812->rmt_channel, pdMS_TO_TICKS(timeout_ms));
+    if (ret == ESP_OK) {
+        ws2812->tx_done_us = esp_timer_get_time();
+    } else {
+        ws2812->tx_pending = true;
+    }
+    return ret;
+}
+
+static esp_err_t ws2812_transmit(ws2812_t *ws2812, ws2812_source_t source, const uint8_t *base, uint32_t size,
+                                 uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    ws2812_wait_reset(ws2812);
+    ws2812->tx_source = ws2812->blackout ? WS2812_SOURCE_BLACK : source;
+    ws2812->tx_base = base;
+    STRIP_CHECK(rmt_write_sample(ws2812->rmt_channel, base, size, true) == ESP_OK,
+                "transmit RMT samples failed", err, ESP_FAIL);
+    return ws2812_wait_tx(ws2812, timeout_ms);
+err:
+    return ret;
+}
+
+esp_err_t led_strip_rmt_ws2812_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
 {
     esp_err_t ret = ESP_OK;
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
     STRIP_CHECK(index < ws2812->strip_len, "index out of the maximum number of leds", err, ESP_ERR_INVALID_ARG);
+    STRIP_CHECK(!ws2812->shader, "shader strips have no pixel buffer", err, ESP_ERR_NOT_SUPPORTED);
+    if (ws2812->layout == LED_STRIP_LAYOUT_PLANAR) {
+        ws2812->buffer[index] = red & 0xFF;
+        ws2812->buffer[ws2812->strip_len + index] = green & 0xFF;
+        ws2812->buffer[2 * ws2812->strip_len + index] = blue & 0xFF;
+        return ESP_OK;
+    }
     uint32_t start = index * 3;
     // In thr order of GRB
     ws2812->buffer[start + 0] = green & 0xFF;
@@ -110,23 +219,105 @@ err:
     return ret;
 }
 
-static esp_err_t ws2812_refresh(led_strip_t *strip, uint32_t timeout_ms)
+esp_err_t led_strip_rmt_ws2812_refresh(led_strip_t *strip, uint32_t timeout_ms)
+{
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    if (ws2812->shader) {
+        // The translator only needs the offsets from tx_base, the buffer (which
+        // doesn't exist) is never read
+        ws2812->shader_pixel = UINT32_MAX;
+        esp_err_t ret = ws2812_transmit(ws2812, WS2812_SOURCE_SHADER, ws2812->buffer, ws2812->strip_len * 3,
+                                        timeout_ms);
+        ws2812->shader_frame++;
+        return ret;
+    }
+    ws2812_source_t source = ws2812->layout == LED_STRIP_LAYOUT_PLANAR ? WS2812_SOURCE_PLANAR : WS2812_SOURCE_GRB;
+    return ws2812_transmit(ws2812, source, ws2812->buffer, ws2812->strip_len * 3, timeout_ms);
+}
+
+esp_err_t led_strip_blackout(led_strip_t *strip, bool blackout, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
+    STRIP_CHECK(strip, "strip can't be null", err, ESP_ERR_INVALID_ARG);
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
-    STRIP_CHECK(rmt_write_sample(ws2812->rmt_channel, ws2812->buffer, ws2812->strip_len * 3, true) == ESP_OK,
-                "transmit RMT samples failed", err, ESP_FAIL);
-    return rmt_wait_tx_done(ws2812->rmt_channel, pdMS_TO_TICKS(timeout_ms));
+    ws2812->blackout = blackout;
+    // Either black or, when leaving the blackout, the untouched buffer
+    return led_strip_rmt_ws2812_refresh(strip, timeout_ms);
 err:
     return ret;
 }
 
-static esp_err_t ws2812_clear(led_strip_t *strip, uint32_t timeout_ms)
+esp_err_t led_strip_get_planes(led_strip_t *strip, uint8_t **red, uint8_t **green, uint8_t **blue, uint32_t *len)
 {
+    esp_err_t ret = ESP_OK;
+    STRIP_CHECK(strip && red && green && blue && len, "arguments can't be null", err, ESP_ERR_INVALID_ARG);
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    STRIP_CHECK(ws2812->layout == LED_STRIP_LAYOUT_PLANAR && !ws2812->shader, "strip doesn't use the planar layout", err,
+                ESP_ERR_INVALID_STATE);
+    *red = ws2812->buffer;
+    *green = ws2812->buffer + ws2812->strip_len;
+    *blue = ws2812->buffer + 2 * ws2812->strip_len;
+    *len = ws2812->strip_len;
+    return ESP_OK;
+err:
+    return ret;
+}
+
+esp_err_t led_strip_refresh_grb(led_strip_t *strip, const uint8_t *grb, uint32_t led_num, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    STRIP_CHECK(strip && grb, "strip and frame can't be null", err, ESP_ERR_INVALID_ARG);
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    STRIP_CHECK(led_num <= ws2812->strip_len, "frame longer than the strip", err, ESP_ERR_INVALID_ARG);
+    // The translator reads the frame in place: no copy into ws2812->buffer
+    return ws2812_transmit(ws2812, WS2812_SOURCE_GRB, grb, led_num * 3, timeout_ms);
+err:
+    return ret;
+}
+
+size_t led_strip_rmt_ws2812_item_num(led_strip_t *strip)
+{
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    // 8 items per byte, 3 bytes per led
+    return ws2812->strip_len * 3 * 8;
+}
+
+void led_strip_rmt_ws2812_encode(led_strip_t *strip, rmt_item32_t *items)
+{
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    ws2812_source_t source = ws2812->layout == LED_STRIP_LAYOUT_PLANAR ? WS2812_SOURCE_PLANAR : WS2812_SOURCE_GRB;
+    if (ws2812->shader) {
+        source = WS2812_SOURCE_SHADER;
+        ws2812->shader_pixel = UINT32_MAX;
+    }
+    size_t item_num;
+    ws2812_encode(ws2812, source, ws2812->buffer, 0, items, ws2812->strip_len * 3, SIZE_MAX, &item_num);
+}
+
+esp_err_t led_strip_rmt_ws2812_write_items(led_strip_t *strip, const rmt_item32_t *items, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    if (ws2812->blackout) {
+        return ws2812_transmit(ws2812, WS2812_SOURCE_BLACK, ws2812->buffer, ws2812->strip_len * 3, timeout_ms);
+    }
+    ws2812_wait_reset(ws2812);
+    STRIP_CHECK(rmt_write_items(ws2812->rmt_channel, items, led_strip_rmt_ws2812_item_num(strip), true) == ESP_OK,
+                "transmit RMT items failed", err, ESP_FAIL);
+    return ws2812_wait_tx(ws2812, timeout_ms);
+err:
+    return ret;
+}
+
+esp_err_t led_strip_rmt_ws2812_clear(led_strip_t *strip, uint32_t timeout_ms)
+{
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    if (ws2812->shader) {
+        return ws2812_transmit(ws2812, WS2812_SOURCE_BLACK, ws2812->buffer, ws2812->strip_len * 3, timeout_ms);
+    }
     // Write zero to turn off all leds
     memset(ws2812->buffer, 0, ws2812->strip_len * 3);
-    return ws2812_refresh(strip, timeout_ms);
+    return led_strip_rmt_ws2812_refresh(strip, timeout_ms);
 }
 
 static esp_err_t ws2812_del(led_strip_t *strip)
@@ -136,37 +327,77 @@ static esp_err_t ws2812_del(led_strip_t *strip)
     return ESP_OK;
 }
 
-led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
+static ws2812_t *ws2812_new(const led_strip_config_t *config, uint32_t buffer_size)
 {
-    led_strip_t *ret = NULL;
+    ws2812_t *ret = NULL;
     STRIP_CHECK(config, "configuration can't be null", err, NULL);
 
-    // 24 bits per led
-    uint32_t ws2812_size = sizeof(ws2812_t) + config->max_leds * 3;
+    uint32_t ws2812_size = sizeof(ws2812_t) + buffer_size;
     ws2812_t *ws2812 = calloc(1, ws2812_size);
     STRIP_CHECK(ws2812, "request memory for ws2812 failed", err, NULL);
 
+    STRIP_CHECK(config->timing_profile <= LED_STRIP_TIMING_CUSTOM, "unknown timing profile", err_free, NULL);
+    const led_strip_timing_t *timing = config->timing_profile == LED_STRIP_TIMING_CUSTOM ?
+                                       &config->custom_timing : &ws2812_timings[config->timing_profile];
     uint32_t counter_clk_hz = 0;
     STRIP_CHECK(rmt_get_counter_clock((rmt_channel_t)config->dev, &counter_clk_hz) == ESP_OK,
-                "get rmt counter clock failed", err, NULL);
+                "get rmt counter clock failed", err_free, NULL);
     // ns -> ticks
     float ratio = (float)counter_clk_hz / 1e9;
-    ws2812_t0h_ticks = (uint32_t)(ratio * WS2812_T0H_NS);
-    ws2812_t0l_ticks = (uint32_t)(ratio * WS2812_T0L_NS);
-    ws2812_t1h_ticks = (uint32_t)(ratio * WS2812_T1H_NS);
-    ws2812_t1l_ticks = (uint32_t)(ratio * WS2812_T1L_NS);
+    uint32_t t0h_ticks = (uint32_t)(ratio * timing->t0h_ns);
+    uint32_t t0l_ticks = (uint32_t)(ratio * timing->t0l_ns);
+    uint32_t t1h_ticks = (uint32_t)(ratio * timing->t1h_ns);
+    uint32_t t1l_ticks = (uint32_t)(ratio * timing->t1l_ns);
+    // RMT durations are 15 bits wide
+    STRIP_CHECK(t0h_ticks && t0l_ticks && t1h_ticks && t1l_ticks &&
+                t0h_ticks < 0x8000 && t0l_ticks < 0x8000 && t1h_ticks < 0x8000 && t1l_ticks < 0x8000,
+                "timing not representable with the RMT counter clock", err_free, NULL);
+    ws2812->bit0 = (rmt_item32_t) {{{ t0h_ticks, 1, t0l_ticks, 0 }}};
+    ws2812->bit1 = (rmt_item32_t) {{{ t1h_ticks, 1, t1l_ticks, 0 }}};
+    ws2812->reset_us = config->reset_us ? config->reset_us : WS2812_RESET_US;
+    ws2812->tx_done_us = esp_timer_get_time();
 
     // set ws2812 to rmt adapter
     rmt_translator_init((rmt_channel_t)config->dev, ws2812_rmt_adapter);
+    rmt_translator_set_context((rmt_channel_t)config->dev, ws2812);
 
     ws2812->rmt_channel = (rmt_channel_t)config->dev;
     ws2812->strip_len = config->max_leds;
+    ws2812->layout = config->layout;
 
-    ws2812->parent.set_pixel = ws2812_set_pixel;
-    ws2812->parent.refresh = ws2812_refresh;
-    ws2812->parent.clear = ws2812_clear;
+    ws2812->parent.set_pixel = led_strip_rmt_ws2812_set_pixel;
+    ws2812->parent.refresh = led_strip_rmt_ws2812_refresh;
+    ws2812->parent.clear = led_strip_rmt_ws2812_clear;
     ws2812->parent.del = ws2812_del;
 
+    return ws2812;
+err_free:
+    free(ws2812);
+err:
+    return ret;
+}
+
+led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
+{
+    led_strip_t *ret = NULL;
+    STRIP_CHECK(config, "configuration can't be null", err, NULL);
+    // 24 bits per led
+    ws2812_t *ws2812 = ws2812_new(config, config->max_leds * 3);
+    STRIP_CHECK(ws2812, "create ws2812 failed", err, NULL);
+    return &ws2812->parent;
+err:
+    return ret;
+}
+
+led_strip_t *led_strip_new_rmt_ws2812_shader(const led_strip_config_t *config, led_strip_shader_t shader, void *arg)
+{
+    led_strip_t *ret = NULL;
+    STRIP_CHECK(config && shader, "configuration and shader can't be null", err, NULL);
+    // No pixel buffer at all: memory doesn't depend on the strip length
+    ws2812_t *ws2812 = ws2812_new(config, 0);
+    STRIP_CHECK(ws2812, "create ws2812 failed", err, NULL);
+    ws2812->shader = shader;
+    ws2812->shader_arg = arg;
     return &ws2812->parent;
 err:
     return ret;
@@ -0,0 +1,34 @@
+#pragma once
+
+// Internals of the ws2812 driver shared with the other parts of this component.
+// Not part of the public API.
+
+#include <stddef.h>
+#include "driver/rmt.h"
+#include "led_strip.h"
+
+/**
+ * @brief Number of RMT items of a whole frame of the strip
+ */
+size_t led_strip_rmt_ws2812_item_num(led_strip_t *strip);
+
+/**
+ * @brief Encode the current content of the strip (what refresh would send, ignoring the blackout)
+ *
+ * @param[in] strip: LED strip
+ * @param[out] items: led_strip_rmt_ws2812_item_num() RMT items
+ */
+void led_strip_rmt_ws2812_encode(led_strip_t *strip, rmt_item32_t *items);
+
+/**
+ * @brief Send a frame encoded by led_strip_rmt_ws2812_encode(), as is
+ *
+ * @param[in] strip: LED strip
+ * @param[in] items: led_strip_rmt_ws2812_item_num() RMT items
+ * @param[in] timeout_ms: timeout value for refreshing task
+ * @return
+ *      - ESP_OK: Send successfully
+ *      - ESP_ERR_TIMEOUT: Send failed because of timeout
+ *      - ESP_FAIL: Send failed because some other error occurred
+ */
+esp_err_t led_strip_rmt_ws2812_write_items(led_strip_t *strip, const rmt_item32_t *items, uint32_t timeout_ms);
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "led_strip_rmt_ws2812_priv.h"
+#include "led_strip_scene_cache.h"
+
+static const char *TAG = "led_strip_scene";
+#define SCENE_CHECK(a, str, goto_tag, ret_value, ...)                             \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+typedef struct scene_s {
+    struct scene_s *next;
+    char name[LED_STRIP_SCENE_NAME_LEN];
+    uint32_t last_used; // value of the cache clock when the scene was last stored or shown
+    rmt_item32_t items[0];
+} scene_t;
+
+struct led_strip_scene_cache_s {
+    led_strip_t *strip;
+    size_t max_bytes;
+    size_t used_bytes;
+    uint32_t clock; // incremented on each use, to find the least recently used scene
+    scene_t *scenes;
+};
+
+static size_t scene_size(led_strip_scene_cache_t *cache)
+{
+    return sizeof(scene_t) + led_strip_rmt_ws2812_item_num(cache->strip) * sizeof(rmt_item32_t);
+}
+
+static scene_t **scene_find(led_strip_scene_cache_t *cache, const char *name)
+{
+    scene_t **link = &cache->scenes;
+    while (*link && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void scene_remove(led_strip_scene_cache_t *cache, scene_t **link)
+{
+    scene_t *scene = *link;
+    *link = scene->next;
+    cache->used_bytes -= scene_size(cache);
+    free(scene);
+}
+
+static void scene_evict_lru(led_strip_scene_cache_t *cache)
+{
+    scene_t **lru = &cache->scenes;
+    for (scene_t **link = &cache->scenes; *link; link = &(*link)->next) {
+        // Unsigned difference: still right when the clock wraps around
+        if (cache->clock - (*link)->last_used > cache->clock - (*lru)->last_used) {
+            lru = link;
+        }
+    }
+    ESP_LOGD(TAG, "evict scene %s", (*lru)->name);
+    scene_remove(cache, lru);
+}
+
+led_strip_scene_cache_t *led_strip_scene_cache_new(led_strip_t *strip, size_t max_bytes)
+{
+    led_strip_scene_cache_t *ret = NULL;
+    SCENE_CHECK(strip, "strip can't be null", err, NULL);
+    led_strip_scene_cache_t *cache = calloc(1, sizeof(led_strip_scene_cache_t));
+    SCENE_CHECK(cache, "request memory for scene cache failed", err, NULL);
+    cache->strip = strip;
+    cache->max_bytes = max_bytes;
+    return cache;
+err:
+    return ret;
+}
+
+esp_err_t led_strip_scene_cache_del(led_strip_scene_cache_t *cache)
+{
+    while (cache->scenes) {
+        scene_remove(cache, &cache->scenes);
+    }
+    free(cache);
+    return ESP_OK;
+}
+
+esp_err_t led_strip_scene_store(led_strip_scene_cache_t *cache, const char *name)
+{
+    esp_err_t ret = ESP_OK;
+    SCENE_CHECK(name && strlen(name) < LED_STRIP_SCENE_NAME_LEN, "invalid scene name", err, ESP_ERR_INVALID_ARG);
+    const size_t size = scene_size(cache);
+    SCENE_CHECK(size <= cache->max_bytes, "a scene takes %u bytes, more than the cache budget", err, ESP_ERR_NO_MEM,
+                (unsigned)size);
+
+    scene_t **link = scene_find(cache, name);
+    if (*link) {
+        scene_remove(cache, link);
+    }
+    while (cache->used_bytes + size > cache->max_bytes) {
+        scene_evict_lru(cache);
+    }
+    scene_t *scene = malloc(size);
+    SCENE_CHECK(scene, "request memory for scene %s failed", err, ESP_ERR_NO_MEM, name);
+    strcpy(scene->name, name);
+    scene->last_used = ++cache->clock;
+    led_strip_rmt_ws2812_encode(cache->strip, scene->items);
+    scene->next = cache->scenes;
+    cache->scenes = scene;
+    cache->used_bytes += size;
+    return ESP_OK;
+err:
+    return ret;
+}
+
+esp_err_t led_strip_scene_show(led_strip_scene_cache_t *cache, const char *name, uint32_t timeout_ms)
+{
+    scene_t *scene = *scene_find(cache, name);
+    if (!scene) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    scene->last_used = ++cache->clock;
+    return led_strip_rmt_ws2812_write_items(cache->strip, scene->items, timeout_ms);
+}
+
+esp_err_t led_strip_scene_forget(led_strip_scene_cache_t *cache, const char *name)
+{
+    scene_t **link = scene_find(cache, name);
+    if (!*link) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    scene_remove(cache, link);
+    return ESP_OK;
+}
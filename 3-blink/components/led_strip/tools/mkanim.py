@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""
+Pack raw RGB frames into an animation image for led_strip_anim.
+
+The input is a raw file of consecutive frames, each made of LED_NUM pixels in
+R, G, B order (3 bytes per pixel). The output can be flashed into a data
+partition, e.g.:
+
+    $ ./mkanim.py --leds 60 --fps 30 frames.rgb anim.bin
+    $ parttool.py write_partition --partition-name=anim --input=anim.bin
+"""
+import argparse
+import struct
+
+MAGIC = 0x3141534C  # "LSA1"
+VERSION = 1
+HEADER_FORMAT = "<IHHIIII"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--leds", type=int, required=True, help="number of LEDs per frame")
+    parser.add_argument("--fps", type=float, required=True, help="frames per second")
+    parser.add_argument("input", help="raw RGB frames")
+    parser.add_argument("output", help="animation image")
+    args = parser.parse_args()
+
+    frame_size = args.leds * 3
+    with open(args.input, "rb") as f:
+        data = f.read()
+    if not data or len(data) % frame_size:
+        parser.error("input size is not a multiple of the frame size ({} bytes)".format(frame_size))
+    frame_num = len(data) // frame_size
+
+    with open(args.output, "wb") as f:
+        f.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, HEADER_SIZE, args.leds, frame_num,
+                            round(1e6 / args.fps), frame_size))
+        for i in range(frame_num):
+            rgb = data[i * frame_size:(i + 1) * frame_size]
+            grb = bytearray(frame_size)
+            # WS2812 wants green first
+            grb[0::3] = rgb[1::3]
+            grb[1::3] = rgb[0::3]
+            grb[2::3] = rgb[2::3]
+            f.write(grb)
+
+
+if __name__ == "__main__":
+    main()
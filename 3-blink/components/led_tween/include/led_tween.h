@@ -0,0 +1,86 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "led_strip.h"
+
+/**
+* @brief Easing curves
+*
+*/
+typedef enum {
+    LED_TWEEN_LINEAR,      /*!< Constant speed */
+    LED_TWEEN_EASE_IN,     /*!< Start slow, end fast (quadratic) */
+    LED_TWEEN_EASE_OUT,    /*!< Start fast, end slow (quadratic) */
+    LED_TWEEN_EASE_IN_OUT, /*!< Start and end slow (quadratic) */
+} led_tween_easing_t;
+
+/**
+* @brief Tween engine Type
+*
+*/
+typedef struct led_tween_s led_tween_t;
+
+/**
+* @brief Create a tween engine
+*
+* @param strip: LED strip (all its pixels start black)
+* @param led_num: number of LEDs of the strip (at most 65535)
+* @param max_active: maximum number of pixels being tweened at the same time
+*
+* @return
+*      Tween engine instance or NULL
+*/
+led_tween_t *led_tween_new(led_strip_t *strip, uint32_t led_num, uint32_t max_active);
+
+/**
+* @brief Free the tween engine (the strip is not deleted)
+*
+* @param tween: tween engine
+*
+* @return
+*      - ESP_OK: Free resources successfully
+*/
+esp_err_t led_tween_del(led_tween_t *tween);
+
+/**
+* @brief Start fading a pixel from its current color to a target color
+*
+* @note If the pixel is already being tweened, the new tween replaces it,
+*       starting from the color the pixel has now.
+*
+* @param tween: tween engine
+* @param index: index of the pixel
+* @param red: red part of target color
+* @param green: green part of target color
+* @param blue: blue part of target color
+* @param frames: duration in frames (i.e. calls of led_tween_step()), 0 sets the color at the next step
+* @param easing: easing curve
+*
+* @return
+*      - ESP_OK: Tween started successfully
+*      - ESP_ERR_INVALID_ARG: Index out of the strip
+*      - ESP_ERR_NO_MEM: Already max_active tweens running
+*/
+esp_err_t led_tween_to(led_tween_t *tween, uint32_t index, uint8_t red, uint8_t green, uint8_t blue,
+                       uint16_t frames, led_tween_easing_t easing);
+
+/**
+* @brief Advance all the active tweens by one frame and write the new colors into the strip
+*
+* @note Only the pixels being tweened are written. The strip is not refreshed.
+*
+* @param tween: tween engine
+*
+* @return
+*      Number of tweens still active after this step
+*/
+uint32_t led_tween_step(led_tween_t *tween);
+
+#ifdef __cplusplus
+}
+#endif
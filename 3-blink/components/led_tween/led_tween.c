@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "led_tween.h"
+
+static const char *TAG = "led_tween";
+#define TWEEN_CHECK(a, str, goto_tag, ret_value, ...)                             \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+// Progress of a tween goes from 0 to 1 in Q16 fixed point
+#define Q16_ONE (1UL << 16)
+#define NO_SLOT (0xFFFF)
+
+typedef struct {
+    uint16_t index;   // pixel
+    uint8_t easing;   // led_tween_easing_t
+    uint8_t start[3]; // R, G, B at the beginning of the tween
+    int16_t delta[3]; // target - start
+    uint32_t step;    // progress made by each frame, Q16
+    uint32_t t;       // progress so far, Q16
+} tween_state_t;
+
+struct led_tween_s {
+    led_strip_t *strip;
+    uint32_t led_num;
+    uint32_t max_active;
+    uint32_t active_num;
+    uint8_t *colors;       // R, G, B last written into each pixel
+    uint16_t *slot;        // position in active[] of the tween of each pixel (below max_active), or NO_SLOT
+    tween_state_t active[0];
+};
+
+// Eased progress, Q16. t is in [0, Q16_ONE]
+static uint32_t ease(uint8_t easing, uint32_t t)
+{
+    uint32_t r = Q16_ONE - t;
+    switch (easing) {
+    case LED_TWEEN_EASE_IN:
+        return ((uint64_t)t * t) >> 16;
+    case LED_TWEEN_EASE_OUT:
+        return Q16_ONE - (((uint64_t)r * r) >> 16);
+    case LED_TWEEN_EASE_IN_OUT:
+        if (t < Q16_ONE / 2) {
+            return ((uint64_t)t * t) >> 15;
+        }
+        return Q16_ONE - (((uint64_t)r * r) >> 15);
+    default:
+        return t;
+    }
+}
+
+static void tween_remove(led_tween_t *tween, uint32_t pos)
+{
+    // Swap with the last one: active[] stays dense, the order doesn't matter
+    tween->slot[tween->active[pos].index] = NO_SLOT;
+    tween->active_num--;
+    if (pos != tween->active_num) {
+        tween->active[pos] = tween->active[tween->active_num];
+        tween->slot[tween->active[pos].index] = pos;
+    }
+}
+
+led_tween_t *led_tween_new(led_strip_t *strip, uint32_t led_num, uint32_t max_active)
+{
+    led_tween_t *ret = NULL;
+    led_tween_t *tween = NULL;
+    TWEEN_CHECK(strip && led_num && led_num <= NO_SLOT && max_active && max_active <= led_num,
+                "invalid arguments", err, NULL);
+    tween = calloc(1, sizeof(led_tween_t) + max_active * sizeof(tween_state_t));
+    TWEEN_CHECK(tween, "request memory for tween engine failed", err, NULL);
+    tween->colors = calloc(led_num, 3);
+    tween->slot = malloc(led_num * sizeof(uint16_t));
+    TWEEN_CHECK(tween->colors && tween->slot, "request memory for tween engine failed", err, NULL);
+    memset(tween->slot, 0xFF, led_num * sizeof(uint16_t));
+    tween->strip = strip;
+    tween->led_num = led_num;
+    tween->max_active = max_active;
+    return tween;
+err:
+    if (tween) {
+        led_tween_del(tween);
+    }
+    return ret;
+}
+
+esp_err_t led_tween_del(led_tween_t *tween)
+{
+    free(tween->colors);
+    free(tween->slot);
+    free(tween);
+    return ESP_OK;
+}
+
+esp_err_t led_tween_to(led_tween_t *tween, uint32_t index, uint8_t red, uint8_t green, uint8_t blue,
+                       uint16_t frames, led_tween_easing_t easing)
+{
+    esp_err_t ret = ESP_OK;
+    TWEEN_CHECK(index < tween->led_num, "index out of the strip", err, ESP_ERR_INVALID_ARG);
+    uint32_t pos = tween->slot[index];
+    if (pos == NO_SLOT) {
+        TWEEN_CHECK(tween->active_num < tween->max_active, "too many active tweens", err, ESP_ERR_NO_MEM);
+        pos = tween->active_num++;
+        tween->slot[index] = pos;
+    }
+    tween_state_t *s = &tween->active[pos];
+    const uint8_t *current = &tween->colors[index * 3];
+    const uint8_t target[3] = { red, green, blue };
+    s->index = index;
+    s->easing = easing;
+    for (int c = 0; c < 3; c++) {
+        s->start[c] = current[c];
+        s->delta[c] = target[c] - current[c];
+    }
+    s->t = 0;
+    // frames == 0 jumps straight to the end. Rounding the step up makes the
+    // tween last at most `frames` frames.
+    s->step = frames ? (Q16_ONE + frames - 1) / frames : 0;
+    if (!frames) {
+        s->t = Q16_ONE;
+    }
+    return ESP_OK;
+err:
+    return ret;
+}
+
+uint32_t led_tween_step(led_tween_t *tween)
+{
+    uint32_t pos = 0;
+    while (pos < tween->active_num) {
+        tween_state_t *s = &tween->active[pos];
+        s->t += s->step;
+        if (s->t > Q16_ONE) {
+            s->t = Q16_ONE;
+        }
+        uint32_t e = ease(s->easing, s->t);
+        uint8_t *color = &tween->colors[s->index * 3];
+        for (int c = 0; c < 3; c++) {
+            // delta * e fits in 32 bits: |delta| < 2^8, e <= 2^16
+            color[c] = s->start[c] + ((s->delta[c] * (int32_t)e) >> 16);
+        }
+        led_strip_set_pixel(tween->strip, s->index, color[0], color[1], color[2]);
+        if (s->t == Q16_ONE) {
+            // Finished: the last slot moves here, so don't advance pos
+            tween_remove(tween, pos);
+        } else {
+            pos++;
+        }
+    }
+    return tween->active_num;
+}
@@ -0,0 +1,48 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "sim.h"
+
+/*
+UART console of each board. The text goes to stdout right away, but the calling task then blocks as long as the UART
+takes to shift it out (10 bits per character), like printf on the real console once the FIFO is full.
+
+Environment variables:
+- SPI_SIM_CONSOLE_BAUD: baud rate of the consoles, 0 (the default) for no limit. 115200 is what the boards use.
+*/
+
+static struct {
+    pthread_mutex_t lock;
+    int64_t busy_until;     // when the UART will have shifted out everything written so far
+} uart[SIM_BOARD_NUM] = {
+    [0 ... SIM_BOARD_NUM - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static long baud = -1;
+
+int sim_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vprintf(format, args);
+    va_end(args);
+
+    if (baud < 0) {
+        const char *env = getenv("SPI_SIM_CONSOLE_BAUD");
+        baud = env ? atol(env) : 0;
+    }
+    if (baud == 0 || len <= 0) {
+        return len;
+    }
+    int board = sim_get_board();
+    pthread_mutex_lock(&uart[board].lock);
+    int64_t now = esp_timer_get_time();
+    int64_t start = uart[board].busy_until > now ? uart[board].busy_until : now;
+    int64_t until = start + (int64_t)len * 10 * 1000000 / baud;
+    uart[board].busy_until = until;
+    pthread_mutex_unlock(&uart[board].lock);
+    sim_sleep_until_us(until);
+    return len;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Forced into the firmware sources (see CMakeLists.txt): their console output goes through the simulated UART
+#include <stdio.h>
+
+int sim_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#define printf(...) sim_printf(__VA_ARGS__)
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <time.h>
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+// Frequency of the simulated CPU, like the ESP32-C3 at its default settings
+#define CPU_MHZ 160
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t start_us;
+
+__attribute__((constructor)) static void esp_timer_init(void)
+{
+    start_us = monotonic_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return monotonic_us() - start_us;
+}
+
+uint32_t esp_cpu_get_ccount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * CPU_MHZ * 1000000 + (uint64_t)ts.tv_nsec * CPU_MHZ / 1000);
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return CPU_MHZ;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    sim_sleep_until_us(esp_timer_get_time() + us);
+}
+
+void sim_sleep_until_us(int64_t us)
+{
+    // The kernel wakes us up tens of microseconds late: sleep for most of the time, spin for the rest
+    const int64_t spin_us = 100;
+    int64_t left = us - esp_timer_get_time();
+    if (left > spin_us) {
+        struct timespec ts = { .tv_sec = (left - spin_us) / 1000000, .tv_nsec = ((left - spin_us) % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+    while (esp_timer_get_time() < us) {
+    }
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return aligned_alloc(4, (size + 3) & ~(size_t)3);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    default: return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "soc/rtc_periph.h"
+#include "sim.h"
+
+#define GPIO_NUM 32
+
+typedef struct {
+    gpio_int_type_t intr_type;
+    gpio_isr_t isr;
+    void *isr_arg;
+} pin_t;
+
+// The wires: pin n of every board is connected to pin n of the others, pulled up
+static int level[GPIO_NUM];
+static pin_t pins[SIM_BOARD_NUM][GPIO_NUM];
+// Interrupts of the boards run one at a time, like on a single core
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+__attribute__((constructor)) static void gpio_init(void)
+{
+    for (int i = 0; i < GPIO_NUM; i++) {
+        level[i] = 1;
+    }
+}
+
+static void set_level(int gpio, int value)
+{
+    pthread_mutex_lock(&lock);
+    if (level[gpio] != value) {
+        level[gpio] = value;
+        // The "ISRs" of every board watching this wire run right away, in the thread that moved it
+        for (int b = 0; b < SIM_BOARD_NUM; b++) {
+            pin_t *pin = &pins[b][gpio];
+            bool fire = pin->intr_type == GPIO_INTR_ANYEDGE ||
+                        (pin->intr_type == GPIO_INTR_POSEDGE && value) ||
+                        (pin->intr_type == GPIO_INTR_NEGEDGE && !value);
+            if (fire && pin->isr) {
+                pin->isr(pin->isr_arg);
+            }
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int i = 0; i < GPIO_NUM; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            gpio_set_intr_type(i, config->intr_type);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&lock);
+    pins[sim_get_board()][gpio_num].intr_type = intr_type;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&lock);
+    pins[sim_get_board()][gpio_num].isr = isr_handler;
+    pins[sim_get_board()][gpio_num].isr_arg = args;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t value)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    set_level(gpio_num, value != 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return level[gpio_num];
+}
+
+void sim_gpio_write_reg(uint32_t reg, uint32_t value)
+{
+    for (int i = 0; i < GPIO_NUM; i++) {
+        if (value & (1UL << i)) {
+            set_level(i, reg == GPIO_OUT_W1TS_REG);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "driver/spi_common.h"
+
+typedef struct spi_slave_transaction_t spi_slave_transaction_t;
+typedef void (*slave_transaction_cb_t)(spi_slave_transaction_t *trans);
+
+typedef struct {
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    uint8_t mode;
+    slave_transaction_cb_t post_setup_cb;
+    slave_transaction_cb_t post_trans_cb;
+} spi_slave_interface_config_t;
+
+struct spi_slave_transaction_t {
+    size_t length;      // bits
+    size_t trans_len;   // bits actually transferred
+    const void *tx_buffer;
+    void *rx_buffer;
+    void *user;
+};
+
+esp_err_t spi_slave_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                               const spi_slave_interface_config_t *slave_config, spi_dma_chan_t dma_chan);
+esp_err_t spi_slave_free(spi_host_device_t host);
+esp_err_t spi_slave_queue_trans(spi_host_device_t host, const spi_slave_transaction_t *trans_desc,
+                                TickType_t ticks_to_wait);
+esp_err_t spi_slave_get_trans_result(spi_host_device_t host, spi_slave_transaction_t **trans_desc,
+                                     TickType_t ticks_to_wait);
+esp_err_t spi_slave_transmit(spi_host_device_t host, spi_slave_transaction_t *trans_desc, TickType_t ticks_to_wait);
@@ -0,0 +1,5 @@
+#pragma once
+
+// Everything is in "RAM" on the host
+#define IRAM_ATTR
+#define DRAM_ATTR
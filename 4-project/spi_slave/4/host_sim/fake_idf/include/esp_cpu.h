@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cycles of a simulated CPU running at esp_rom_get_cpu_ticks_per_us() MHz, derived from the host clock
+uint32_t esp_cpu_get_ccount(void);
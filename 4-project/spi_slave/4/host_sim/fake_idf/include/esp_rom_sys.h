@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
+void esp_rom_delay_us(uint32_t us);
@@ -0,0 +1,3 @@
+#pragma once
+
+// Nothing from this header is used by the firmwares: it only has to exist
@@ -0,0 +1,71 @@
+#pragma once
+
+// Configuration of the simulated firmwares. The bool options (CONFIG_SPI_CLOCK_TRAINING, CONFIG_SPI_BATCH,
+// CONFIG_SPI_COMPRESS, CONFIG_SPI_FAST_PATH, CONFIG_SPI_BENCHMARK)
+// are set by CMakeLists.txt, like the values that have a cache variable there.
+
+#define CONFIG_IDF_TARGET_ESP32C3 1
+
+#ifndef CONFIG_SPI_LINK_MAX_PAYLOAD
+#define CONFIG_SPI_LINK_MAX_PAYLOAD 1008
+#endif
+#ifndef CONFIG_SPI_CLOCK_HZ
+#define CONFIG_SPI_CLOCK_HZ 5000000
+#endif
+#ifndef CONFIG_SPI_PIPELINE_DEPTH
+#define CONFIG_SPI_PIPELINE_DEPTH 3
+#endif
+#ifndef CONFIG_SPI_QUEUE_DEPTH
+#define CONFIG_SPI_QUEUE_DEPTH CONFIG_SPI_PIPELINE_DEPTH
+#endif
+#ifndef CONFIG_SPI_RX_RING_SIZE
+#define CONFIG_SPI_RX_RING_SIZE 16
+#endif
+#ifndef CONFIG_SPI_OUTBOUND_QUEUE_SIZE
+#define CONFIG_SPI_OUTBOUND_QUEUE_SIZE 32
+#endif
+#ifndef CONFIG_SPI_HANDSHAKE_FILTER_PERCENT
+#define CONFIG_SPI_HANDSHAKE_FILTER_PERCENT 50
+#endif
+
+#if CONFIG_SPI_CLOCK_TRAINING
+#ifndef CONFIG_SPI_CLOCK_MAX_HZ
+#define CONFIG_SPI_CLOCK_MAX_HZ 40000000
+#endif
+#ifndef CONFIG_SPI_TRAINING_MARGIN_STEPS
+#define CONFIG_SPI_TRAINING_MARGIN_STEPS 1
+#endif
+#ifndef CONFIG_SPI_RETRAIN_ERROR_PERCENT
+#define CONFIG_SPI_RETRAIN_ERROR_PERCENT 2
+#endif
+#endif
+
+#if CONFIG_SPI_FAST_PATH
+#ifndef CONFIG_SPI_FAST_PATH_MAX_PAYLOAD
+#define CONFIG_SPI_FAST_PATH_MAX_PAYLOAD 32
+#endif
+#endif
+
+#if !CONFIG_SPI_BENCHMARK
+#ifndef CONFIG_SPI_CONTROL_PERIOD_MS
+#define CONFIG_SPI_CONTROL_PERIOD_MS 100
+#endif
+#ifndef CONFIG_SPI_SENSOR_PERIOD_MS
+#define CONFIG_SPI_SENSOR_PERIOD_MS 100
+#endif
+#ifndef CONFIG_SPI_SENSOR_BURST
+#define CONFIG_SPI_SENSOR_BURST 8
+#endif
+#endif
+
+#if CONFIG_SPI_BENCHMARK
+#ifndef CONFIG_SPI_BENCHMARK_MIN_PAYLOAD
+#define CONFIG_SPI_BENCHMARK_MIN_PAYLOAD 16
+#endif
+#ifndef CONFIG_SPI_BENCHMARK_MAX_PAYLOAD
+#define CONFIG_SPI_BENCHMARK_MAX_PAYLOAD 1008
+#endif
+#ifndef CONFIG_SPI_BENCHMARK_DURATION_MS
+#define CONFIG_SPI_BENCHMARK_DURATION_MS 2000
+#endif
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// GPIO output registers: writing a mask sets (W1TS) or clears (W1TC) the output of those pins
+#define GPIO_OUT_W1TS_REG 1
+#define GPIO_OUT_W1TC_REG 2
+
+void sim_gpio_write_reg(uint32_t reg, uint32_t value);
+
+#define WRITE_PERI_REG(addr, val) sim_gpio_write_reg((addr), (val))
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Number of simulated boards: each one has its own GPIO matrix, they share the wires
+#define SIM_BOARD_NUM 2
+
+// Board of the calling thread, inherited by the tasks it creates
+void sim_set_board(int board);
+int sim_get_board(void);
+
+// Sleep until the given esp_timer_get_time(), precisely even for a few microseconds
+void sim_sleep_until_us(int64_t us);
@@ -0,0 +1,281 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/spi_master.h"
+#include "driver/spi_slave.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "sim.h"
+
+static const char *TAG = "sim_spi";
+
+// One bus, with the master of one board and the slave of the other at its ends. A transfer takes the time needed to
+// clock its bits, plus a fixed overhead for the driver and the CS line.
+#define TRANS_OVERHEAD_US 5
+
+struct spi_device_t {
+    spi_device_interface_config_t config;
+    QueueHandle_t pending;  // queued by the task, waiting for the bus
+    QueueHandle_t done;     // waiting for spi_device_get_trans_result()
+    pthread_t thread;       // the "hardware": runs the transactions one after the other
+};
+
+static struct {
+    pthread_mutex_t lock;
+    bool initialized;
+    spi_slave_interface_config_t config;
+    QueueHandle_t pending;
+    QueueHandle_t done;
+    spi_slave_transaction_t *loaded;    // transaction loaded in the hardware, ready for the master...
+    bool active;                        // ...or being transferred: nothing else can be loaded meanwhile
+    unsigned seed;
+} slave = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// The wires: above max_hz, or always with bit_error_ppm, bits get flipped on the way
+static struct {
+    int max_hz;
+    uint32_t bit_error_ppm;
+    uint32_t overclock_error_ppm;
+} wire;
+
+static int env_int(const char *name, int def)
+{
+    const char *value = getenv(name);
+    return value ? atoi(value) : def;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, spi_dma_chan_t dma_chan)
+{
+    wire.max_hz = env_int("SPI_SIM_MAX_HZ", 26666666);
+    wire.bit_error_ppm = env_int("SPI_SIM_BIT_ERROR_PPM", 0);
+    wire.overclock_error_ppm = env_int("SPI_SIM_OVERCLOCK_ERROR_PPM", 1000);
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+    return ESP_OK;
+}
+
+// Copy len bytes over the wire, flipping each bit with the given probability
+static void wire_copy(uint8_t *dst, const uint8_t *src, size_t len, uint32_t error_ppm)
+{
+    if (!dst) {
+        return;
+    }
+    if (src) {
+        memcpy(dst, src, len);
+    } else {
+        memset(dst, 0, len);
+    }
+    if (!error_ppm) {
+        return;
+    }
+    for (size_t i = 0; i < len * 8; i++) {
+        if ((uint32_t)(rand_r(&slave.seed) % 1000000) < error_ppm) {
+            dst[i / 8] ^= 1 << (i % 8);
+        }
+    }
+}
+
+// Load the next queued transaction in the slave hardware, if it is idle. Called with slave.lock held.
+static void slave_load_next(void)
+{
+    if (slave.loaded || slave.active || xQueueReceive(slave.pending, &slave.loaded, 0) != pdTRUE) {
+        return;
+    }
+    if (slave.config.post_setup_cb) {
+        slave.config.post_setup_cb(slave.loaded);
+    }
+}
+
+static void transfer(struct spi_device_t *dev, spi_transaction_t *t)
+{
+    size_t bits = t->length;
+    int64_t start = esp_timer_get_time();
+    // The slave transaction is the one loaded when CS goes low. If there is none, the slave misses this transfer.
+    pthread_mutex_lock(&slave.lock);
+    spi_slave_transaction_t *st = slave.loaded;
+    slave.loaded = NULL;
+    slave.active = st != NULL;
+    pthread_mutex_unlock(&slave.lock);
+
+    sim_sleep_until_us(start + TRANS_OVERHEAD_US + (int64_t)bits * 1000000 / dev->config.clock_speed_hz);
+
+    uint32_t error_ppm = wire.bit_error_ppm;
+    if (dev->config.clock_speed_hz > wire.max_hz) {
+        error_ppm += wire.overclock_error_ppm;
+    }
+    pthread_mutex_lock(&slave.lock);
+    if (st) {
+        size_t slave_bits = bits < st->length ? bits : st->length;
+        wire_copy(st->rx_buffer, t->tx_buffer, slave_bits / 8, error_ppm);
+        wire_copy(t->rx_buffer, st->tx_buffer, slave_bits / 8, error_ppm);
+        if (t->rx_buffer && bits > slave_bits) {
+            // Nothing on MISO after the end of the slave transaction
+            memset((uint8_t *)t->rx_buffer + slave_bits / 8, 0xFF, (bits - slave_bits) / 8);
+        }
+        st->trans_len = slave_bits;
+        slave.active = false;
+        if (slave.config.post_trans_cb) {
+            slave.config.post_trans_cb(st);
+        }
+        xQueueSend(slave.done, &st, portMAX_DELAY);
+        slave_load_next();
+    } else if (t->rx_buffer) {
+        memset(t->rx_buffer, 0xFF, bits / 8);
+    }
+    pthread_mutex_unlock(&slave.lock);
+}
+
+static void *device_thread(void *arg)
+{
+    struct spi_device_t *dev = arg;
+    while (1) {
+        spi_transaction_t *t;
+        xQueueReceive(dev->pending, &t, portMAX_DELAY);
+        if (!t) {
+            // Device removed
+            return NULL;
+        }
+        transfer(dev, t);
+        if (dev->config.post_cb) {
+            dev->config.post_cb(t);
+        }
+        xQueueSend(dev->done, &t, portMAX_DELAY);
+    }
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle)
+{
+    if (dev_config->clock_speed_hz <= 0 || dev_config->queue_size <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct spi_device_t *dev = calloc(1, sizeof(*dev));
+    if (!dev) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->config = *dev_config;
+    // One more slot in pending for the stop request
+    dev->pending = xQueueCreate(dev_config->queue_size + 1, sizeof(spi_transaction_t *));
+    dev->done = xQueueCreate(dev_config->queue_size, sizeof(spi_transaction_t *));
+    pthread_create(&dev->thread, NULL, device_thread, dev);
+    *handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    if (uxQueueMessagesWaiting(handle->pending) || uxQueueMessagesWaiting(handle->done)) {
+        ESP_LOGE(TAG, "device has transactions in flight");
+        return ESP_ERR_INVALID_STATE;
+    }
+    spi_transaction_t *stop = NULL;
+    xQueueSend(handle->pending, &stop, portMAX_DELAY);
+    pthread_join(handle->thread, NULL);
+    vQueueDelete(handle->pending);
+    vQueueDelete(handle->done);
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait)
+{
+    if (trans_desc->length % 8) {
+        // Whole bytes only, enough for the firmwares
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return xQueueSend(handle->pending, &trans_desc, ticks_to_wait) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                      TickType_t ticks_to_wait)
+{
+    return xQueueReceive(handle->done, trans_desc, ticks_to_wait) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    esp_err_t ret = spi_device_queue_trans(handle, trans_desc, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    spi_transaction_t *done;
+    return spi_device_get_trans_result(handle, &done, portMAX_DELAY);
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    // Without interrupts nor a task switch: the calling task does the transfer itself
+    if (uxQueueMessagesWaiting(handle->pending) || uxQueueMessagesWaiting(handle->done)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    transfer(handle, trans_desc);
+    if (handle->config.post_cb) {
+        handle->config.post_cb(trans_desc);
+    }
+    return ESP_OK;
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait)
+{
+    return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t dev)
+{
+}
+
+esp_err_t spi_slave_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                               const spi_slave_interface_config_t *slave_config, spi_dma_chan_t dma_chan)
+{
+    pthread_mutex_lock(&slave.lock);
+    slave.config = *slave_config;
+    slave.pending = xQueueCreate(slave_config->queue_size, sizeof(spi_slave_transaction_t *));
+    slave.done = xQueueCreate(slave_config->queue_size, sizeof(spi_slave_transaction_t *));
+    slave.seed = 1;
+    slave.initialized = true;
+    pthread_mutex_unlock(&slave.lock);
+    return ESP_OK;
+}
+
+esp_err_t spi_slave_free(spi_host_device_t host)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t spi_slave_queue_trans(spi_host_device_t host, const spi_slave_transaction_t *trans_desc,
+                                TickType_t ticks_to_wait)
+{
+    if (!slave.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xQueueSend(slave.pending, &trans_desc, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    pthread_mutex_lock(&slave.lock);
+    slave_load_next();
+    pthread_mutex_unlock(&slave.lock);
+    return ESP_OK;
+}
+
+esp_err_t spi_slave_get_trans_result(spi_host_device_t host, spi_slave_transaction_t **trans_desc,
+                                     TickType_t ticks_to_wait)
+{
+    if (!slave.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return xQueueReceive(slave.done, trans_desc, ticks_to_wait) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spi_slave_transmit(spi_host_device_t host, spi_slave_transaction_t *trans_desc, TickType_t ticks_to_wait)
+{
+    esp_err_t ret = spi_slave_queue_trans(host, trans_desc, ticks_to_wait);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    spi_slave_transaction_t *done;
+    return spi_slave_get_trans_result(host, &done, ticks_to_wait);
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim.h"
+
+/*
+Host simulation of the sender and receiver firmwares of step 4.
+
+Both firmwares are compiled as they are, with their app_main renamed, against fake_idf: a stand-in for FreeRTOS, the
+SPI master and slave drivers and the GPIO matrix, built on threads. Each firmware runs as the task of its own board,
+board 0 being the receiver and board 1 the sender. The boards share the wires: the handshake line moved by the
+receiver raises the GPIO interrupt of the sender, and a transfer lasts as long as its bits take at the clock of the
+sender. See fake_idf/spi.c for the environment variables that make the wires unreliable.
+*/
+
+void sender_app_main(void);
+void receiver_app_main(void);
+
+static void run(void *arg)
+{
+    void (*app_main)(void) = arg;
+    app_main();
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // The receiver starts first: the sender doesn't see its first handshake edge
+    sim_set_board(0);
+    xTaskCreate(run, "receiver", 4096, receiver_app_main, 1, NULL);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    sim_set_board(1);
+    xTaskCreate(run, "sender", 4096, sender_app_main, 1, NULL);
+
+    sleep(seconds);
+    printf("Simulation over after %d s\n", seconds);
+    // The firmwares never return
+    exit(0);
+}
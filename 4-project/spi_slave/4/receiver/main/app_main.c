@@ -0,0 +1,555 @@
+/* SPI Slave example, receiver (uses SPI Slave driver to communicate with sender)
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+#include "lwip/netdb.h"
+#include "lwip/igmp.h"
+
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "esp_event.h"
+#include "nvs_flash.h"
+#include "soc/rtc_periph.h"
+#include "driver/spi_slave.h"
+#include "esp_log.h"
+#include "esp_spi_flash.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+
+#include "spi_link.h"
+#include "spi_link_batch.h"
+
+
+
+
+/*
+SPI receiver (slave) example.
+
+This example is supposed to work together with the SPI sender. It uses the standard SPI pins (MISO, MOSI, SCLK, CS) to
+transmit data over in a full-duplex fashion, that is, while the master puts data on the MOSI pin, the slave puts its own
+data on the MISO pin.
+
+This example uses one extra pin: GPIO_HANDSHAKE is used as a handshake pin. After a transmission has been set up and we're
+ready to send/receive data, this code uses a callback to set the handshake pin high. The sender will detect this and start
+sending a transaction. As soon as the transaction is done, the line gets set low again.
+*/
+
+/*
+The receiver keeps QUEUE_DEPTH transactions queued in the SPI slave driver with spi_slave_queue_trans, each one with its
+own descriptor, and collects them with spi_slave_get_trans_result. As soon as a transaction is done, the driver loads
+the next queued one and signals the master again through the handshake line: the master never waits for the receiver
+to print the data and to re-arm a transaction.
+
+Printing on the UART console is slow, so the payloads aren't handled here either: the receiver task hands each completed
+frame over to a consumer task through a lock-free single-producer/single-consumer ring, and goes straight back to
+re-arming transactions. When the consumer falls behind and the ring fills up, the payloads are either held back by the
+link (the sender is told to wait, see spi_link_set_rx_room()) or dropped and counted, depending on
+CONFIG_SPI_RX_RING_FULL_HOLD: in neither case does a slow consumer stall the bus.
+
+Each transaction carries a frame (see spi_link_frame.h): a header with the payload length, followed by the payload. The master decides how long a transaction is, so transactions are armed for the largest frame, and the length
+of the received frame comes from its header and from the number of bits actually transferred. Frames live in
+DMA-capable buffers taken from a pool (see spi_link_pool.h), which the driver uses as they are, without copying them.
+A completed transaction is re-armed with fresh buffers first, and its payload is printed afterwards.
+
+Frames are numbered and protected by a CRC, and each side acknowledges what it received in its own frames (see
+spi_link.h). Frames that are lost or corrupted are sent again, and duplicates are discarded.
+
+A payload flagged as a batch holds several messages of the sender, each one prefixed by its length (see
+spi_link_batch.h): they are taken out and handled one by one. With CONFIG_SPI_COMPRESS, batches can come compressed
+(and go upstream compressed), if both sides say they can take them: they are decoded first.
+
+SPI is full duplex, so the receiver has its own messages to send upstream: any task can add them to an outbound queue
+(send_upstream()), and the receiver task packs them into batches, which go out on MISO during the next transactions of
+the master. A sensor task stands in for the producer of such messages: it reads a burst of samples every
+CONFIG_SPI_SENSOR_PERIOD_MS. While messages are waiting, the frames of the receiver are flagged with
+SPI_LINK_FLAG_MORE, and the sender makes its transactions long enough for a full frame of ours, even when it has
+nothing to say itself: the data comes upstream without the sender having to poll for it.
+
+With CONFIG_SPI_BENCHMARK, the receiver checks the patterned payloads streamed by the sender and prints a summary
+every few seconds, instead of printing each message. Nothing is sent upstream.
+*/
+
+/*
+Pins in use. The SPI Master can use the GPIO mux, so feel free to change these if needed.
+*/
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 12
+#define GPIO_MISO 13
+#define GPIO_SCLK 15
+#define GPIO_CS 14
+
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define GPIO_HANDSHAKE 8
+#define GPIO_MOSI 7
+#define GPIO_MISO 2
+#define GPIO_SCLK 6
+#define GPIO_CS 10
+
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 11
+#define GPIO_MISO 13
+#define GPIO_SCLK 12
+#define GPIO_CS 10
+
+#endif //CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+
+
+#ifdef CONFIG_IDF_TARGET_ESP32
+#define RCV_HOST    HSPI_HOST
+
+#else
+#define RCV_HOST    SPI2_HOST
+
+#endif
+
+
+
+//Transactions that can be queued in the SPI slave driver at the same time
+#define QUEUE_DEPTH CONFIG_SPI_QUEUE_DEPTH
+
+//Transaction descriptors, which must stay untouched while they are queued
+static spi_slave_transaction_t trans[QUEUE_DEPTH];
+
+//Frames sent and not acknowledged yet, at most
+#define LINK_WINDOW 8
+
+//Frame buffers: the window, plus one to send and one to receive for each queued transaction and for the one being
+//looked at, plus the ones waiting in the ring, plus the open batch of upstream messages
+static spi_link_pool_t *pool;
+static spi_link_t *link;
+static spi_link_batch_t *batch;
+
+//The receiver task re-arms the transactions, so it runs above the consumer and sensor tasks
+#define RECEIVER_TASK_PRIORITY 5
+#define CONSUMER_TASK_PRIORITY 2
+#define CONSUMER_TASK_STACK 4096
+#define SENSOR_TASK_PRIORITY 3
+#define SENSOR_TASK_STACK 4096
+
+//Messages waiting to go upstream, to the sender: any task can add to the queue, the receiver task empties it
+#define OUTBOUND_QUEUE_SIZE CONFIG_SPI_OUTBOUND_QUEUE_SIZE
+#define OUTBOUND_MSG_MAX 32
+
+typedef struct {
+    uint8_t len;
+    uint8_t data[OUTBOUND_MSG_MAX];
+} outbound_msg_t;
+
+static QueueHandle_t outbound;
+static volatile uint32_t outbound_dropped=0;    //Messages that didn't fit in the queue
+
+//Received frames waiting for the consumer task
+#define RX_RING_SIZE CONFIG_SPI_RX_RING_SIZE
+_Static_assert((RX_RING_SIZE&(RX_RING_SIZE-1))==0, "the ring size must be a power of 2");
+
+typedef struct {
+    uint8_t *frame;             //Received frame, given back to the pool by the consumer
+    const uint8_t *payload;     //Inside the frame
+    size_t len;
+} rx_item_t;
+
+//Each index is written by one side only: the receiver task puts frames at rx_tail, the consumer task takes them at
+//rx_head. The counters run freely, the slot is the counter modulo the size.
+static rx_item_t rx_ring[RX_RING_SIZE];
+static atomic_uint rx_tail;
+static atomic_uint rx_head;
+static TaskHandle_t consumer;
+
+//Written by the receiver task, read by the consumer task for the statistics
+static volatile uint32_t rx_dropped=0;      //Payloads dropped because the ring was full
+static volatile uint32_t rx_max_waiting=0;  //Most payloads waiting in the ring at once
+
+#if CONFIG_SPI_RX_RING_FULL_HOLD
+//Receiver task: frames waiting in the ring. The consumer can only make it decrease behind our back.
+static unsigned rx_ring_count(void)
+{
+    return atomic_load_explicit(&rx_tail, memory_order_relaxed)-atomic_load_explicit(&rx_head, memory_order_acquire);
+}
+#endif
+
+//Receiver task: hand a frame over to the consumer, unless the ring is full
+static bool rx_ring_push(uint8_t *frame, const uint8_t *payload, size_t len)
+{
+    unsigned tail=atomic_load_explicit(&rx_tail, memory_order_relaxed);
+    unsigned waiting=tail-atomic_load_explicit(&rx_head, memory_order_acquire);
+    if (waiting==RX_RING_SIZE) {
+        return false;
+    }
+    rx_ring[tail%RX_RING_SIZE]=(rx_item_t){ .frame=frame, .payload=payload, .len=len };
+    //Publish the item to the consumer
+    atomic_store_explicit(&rx_tail, tail+1, memory_order_release);
+    if (waiting+1>rx_max_waiting) rx_max_waiting=waiting+1;
+    xTaskNotifyGive(consumer);
+    return true;
+}
+
+//Consumer task: take the oldest frame, if any
+static bool rx_ring_pop(rx_item_t *item)
+{
+    unsigned head=atomic_load_explicit(&rx_head, memory_order_relaxed);
+    if (head==atomic_load_explicit(&rx_tail, memory_order_acquire)) {
+        return false;
+    }
+    *item=rx_ring[head%RX_RING_SIZE];
+    //Hand the slot back to the receiver task
+    atomic_store_explicit(&rx_head, head+1, memory_order_release);
+    return true;
+}
+
+#if !CONFIG_SPI_BENCHMARK
+//Queue a message for the sender, from any task. Fails if the queue stays full longer than ticks_to_wait.
+static bool send_upstream(const void *data, size_t len, TickType_t ticks_to_wait)
+{
+    outbound_msg_t msg;
+    assert(len<=OUTBOUND_MSG_MAX);
+    msg.len=len;
+    memcpy(msg.data, data, len);
+    if (xQueueSend(outbound, &msg, ticks_to_wait)!=pdPASS) {
+        outbound_dropped++;
+        return false;
+    }
+    return true;
+}
+#endif
+
+//Receiver task: move the messages of the outbound queue into batches, as long as the window of the link has room,
+//and tell the link how many are still waiting. A batch is submitted when it's full, or as soon as the queue is empty:
+//nothing else is coming for now.
+static void drain_outbound(void)
+{
+    outbound_msg_t msg;
+    while (xQueuePeek(outbound, &msg, 0)==pdPASS) {
+        if (spi_link_batch_add(batch, msg.data, msg.len)!=ESP_OK) {
+            //Batch and window full: the message stays in the queue
+            break;
+        }
+        xQueueReceive(outbound, &msg, 0);
+    }
+    UBaseType_t waiting=uxQueueMessagesWaiting(outbound);
+    if (waiting==0) {
+        spi_link_batch_flush(batch);
+    }
+    spi_link_set_tx_backlog(link, waiting+spi_link_batch_pending(batch));
+}
+
+//Arm a transaction that can receive the largest frame, with new buffers
+static void queue_trans(spi_slave_transaction_t *t)
+{
+    //The frame to send: one that got lost, a new one, or just the acknowledgements. The master decides how much of
+    //it is transferred.
+    size_t size;
+    uint8_t *sendbuf=spi_link_prepare_tx(link, &size);
+    uint8_t *recvbuf=spi_link_pool_acquire(pool, portMAX_DELAY);
+    memset(t, 0, sizeof(*t));
+    t->length=SPI_LINK_MAX_FRAME*8;
+    t->tx_buffer=sendbuf;
+    t->rx_buffer=recvbuf;
+    esp_err_t ret=spi_slave_queue_trans(RCV_HOST, t, portMAX_DELAY);
+    assert(ret==ESP_OK);
+}
+
+//Called after a transaction is queued and ready for pickup by master. We use this to set the handshake line high.
+void my_post_setup_cb(spi_slave_transaction_t *trans) {
+    WRITE_PERI_REG(GPIO_OUT_W1TC_REG, (1<<GPIO_HANDSHAKE));
+}
+
+//Called after transaction is sent/received. We use this to set the handshake line low.
+void my_post_trans_cb(spi_slave_transaction_t *trans) {
+    WRITE_PERI_REG(GPIO_OUT_W1TS_REG, (1<<GPIO_HANDSHAKE));
+}
+
+#if CONFIG_SPI_BENCHMARK
+//Seconds between two summaries
+#define SUMMARY_PERIOD_S 5
+
+static uint32_t bench_payloads=0;
+static uint64_t bench_bytes=0;
+static uint32_t bench_errors=0;
+
+//Payload number n is the number, then bytes counting up from it: see fill_pattern() in the sender
+static void check_pattern(const uint8_t *payload, size_t len)
+{
+    uint32_t n=0;
+    for (size_t i=0; i<len && i<4; i++) {
+        n|=(uint32_t)payload[i]<<(8*i);
+    }
+    for (size_t i=4; i<len; i++) {
+        if (payload[i]!=(uint8_t)(n+i)) {
+            bench_errors++;
+            break;
+        }
+    }
+    bench_payloads++;
+    bench_bytes+=len;
+}
+
+#endif
+
+//Called by the consumer task. The link belongs to the receiver task, but its counters can be read: at worst they are
+//a transfer old.
+static void print_ring_stats(void)
+{
+    spi_link_stats_t stats;
+    spi_link_get_stats(link, &stats);
+    printf("Ring: %u dropped, %u refused by the link, at most %u of %d waiting\n", (unsigned)rx_dropped,
+            (unsigned)stats.rx_refused, (unsigned)rx_max_waiting, RX_RING_SIZE);
+#if !CONFIG_SPI_BENCHMARK
+    spi_link_batch_stats_t bstats;
+    spi_link_batch_get_stats(batch, &bstats);
+    printf("Upstream: %u messages in %u batches, %u dropped, %u waiting\n", (unsigned)bstats.messages,
+            (unsigned)bstats.batches, (unsigned)outbound_dropped, (unsigned)uxQueueMessagesWaiting(outbound));
+#if CONFIG_SPI_COMPRESS
+    printf("Upstream: %u batches compressed, %llu bytes sent as %llu\n", (unsigned)bstats.packed,
+            (unsigned long long)bstats.raw_bytes, (unsigned long long)bstats.sent_bytes);
+#endif
+#endif
+}
+
+#if CONFIG_SPI_BENCHMARK
+static void print_summary(int64_t elapsed_us)
+{
+    spi_link_stats_t stats;
+    spi_link_get_stats(link, &stats);
+    printf("Benchmark: %u payloads (%u/s), %u B/s, %u wrong, %u duplicates, %u CRC errors, %u truncated\n",
+            (unsigned)bench_payloads, (unsigned)(bench_payloads*1000000LL/elapsed_us),
+            (unsigned)(bench_bytes*1000000LL/elapsed_us), (unsigned)bench_errors,
+            (unsigned)stats.rx_duplicates, (unsigned)stats.rx_crc_errors, (unsigned)stats.rx_truncated);
+    print_ring_stats();
+    bench_payloads=0;
+    bench_bytes=0;
+}
+#endif
+
+static void handle_message(const uint8_t *msg, size_t len)
+{
+#if CONFIG_SPI_BENCHMARK
+    check_pattern(msg, len);
+#else
+    printf("Received: %.*s\n", (int)len, (const char*)msg);
+#endif
+}
+
+#if CONFIG_SPI_COMPRESS
+//Consumer task: room for a compressed batch of the sender, once decoded
+static uint8_t unpack_buf[SPI_LINK_MAX_PAYLOAD];
+#endif
+
+//Pass the messages of a payload received to handle_message: one, or all those of a batch
+static void deliver(const uint8_t *frame, const uint8_t *payload, size_t len)
+{
+    if (!(spi_link_frame_header(frame)->flags&SPI_LINK_FLAG_BATCH)) {
+        handle_message(payload, len);
+        return;
+    }
+    const uint8_t *msg;
+    size_t msg_len;
+    esp_err_t ret=ESP_OK;
+#if CONFIG_SPI_COMPRESS
+    ret=spi_link_batch_unpack(&payload, &len, unpack_buf, sizeof(unpack_buf));
+#endif
+    while (ret==ESP_OK && (ret=spi_link_batch_next(&payload, &len, &msg, &msg_len))==ESP_OK) {
+        handle_message(msg, msg_len);
+    }
+    if (ret!=ESP_ERR_NOT_FOUND) {
+        printf("Malformed batch: %s\n", esp_err_to_name(ret));
+    }
+}
+
+//Handle the payloads received, away from the receiver task: however slow this is, the transactions keep going
+static void consumer_task(void *arg)
+{
+#if CONFIG_SPI_BENCHMARK
+    int64_t summary_at=esp_timer_get_time();
+#else
+    uint32_t consumed=0;
+#endif
+    while (1) {
+        //One notification per frame pushed, but they're all taken at once. Wake up anyway from time to time, for the
+        //summary.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        rx_item_t item;
+        while (rx_ring_pop(&item)) {
+            deliver(item.frame, item.payload, item.len);
+            spi_link_pool_release(pool, item.frame);
+#if !CONFIG_SPI_BENCHMARK
+            if (++consumed%1000==0) {
+                print_ring_stats();
+            }
+#endif
+        }
+#if CONFIG_SPI_BENCHMARK
+        int64_t now=esp_timer_get_time();
+        if (now-summary_at>=SUMMARY_PERIOD_S*1000000LL) {
+            print_summary(now-summary_at);
+            summary_at=now;
+        }
+#endif
+    }
+}
+
+#if !CONFIG_SPI_BENCHMARK
+//Stand-in for a sensor with a FIFO: a burst of CONFIG_SPI_SENSOR_BURST samples every CONFIG_SPI_SENSOR_PERIOD_MS,
+//sent upstream
+static void sensor_task(void *arg)
+{
+    uint32_t n=0;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_SPI_SENSOR_PERIOD_MS));
+        for (int i=0; i<CONFIG_SPI_SENSOR_BURST; i++) {
+            char msg[OUTBOUND_MSG_MAX];
+            //A temperature slowly going up and down between 20 and 30 degrees
+            int mdeg=20000+(int)(n%2000<1000 ? n%2000 : 2000-n%2000)*10;
+            int len=snprintf(msg, sizeof(msg), "Sample %u: %d.%03d C", (unsigned)n, mdeg/1000, mdeg%1000);
+            //Don't wait: a sensor can't be held back, a full queue loses the sample
+            send_upstream(msg, len, 0);
+            n++;
+        }
+    }
+}
+#endif
+
+//Main application
+void app_main(void)
+{
+    esp_err_t ret;
+
+    //Configuration for the SPI bus
+    spi_bus_config_t buscfg={
+        .mosi_io_num=GPIO_MOSI,
+        .miso_io_num=GPIO_MISO,
+        .sclk_io_num=GPIO_SCLK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz=SPI_LINK_MAX_FRAME,   //Every transaction is armed for a full frame
+    };
+
+    //Configuration for the SPI slave interface
+    spi_slave_interface_config_t slvcfg={
+        .mode=0,
+        .spics_io_num=GPIO_CS,
+        .queue_size=QUEUE_DEPTH,
+        .flags=0,
+        .post_setup_cb=my_post_setup_cb,
+        .post_trans_cb=my_post_trans_cb
+    };
+
+    //Configuration for the handshake line
+    gpio_config_t io_conf={
+        .intr_type=GPIO_INTR_DISABLE,
+        .mode=GPIO_MODE_OUTPUT,
+        .pull_up_en=1,
+        .pin_bit_mask=(1<<GPIO_HANDSHAKE)
+    };
+
+    //Configure handshake line as output
+    gpio_config(&io_conf);
+    //Enable pull-ups on SPI lines so we don't detect rogue pulses when no master is connected.
+    gpio_set_pull_mode(GPIO_MOSI, GPIO_PULLUP_ONLY);
+    gpio_set_pull_mode(GPIO_SCLK, GPIO_PULLUP_ONLY);
+    gpio_set_pull_mode(GPIO_CS, GPIO_PULLUP_ONLY);
+
+    //Initialize SPI slave interface
+    ret=spi_slave_initialize(RCV_HOST, &buscfg, &slvcfg, SPI_DMA_CH_AUTO);
+    assert(ret==ESP_OK);
+
+    //Allocate the frame buffers and set up our end of the link
+    ret=spi_link_pool_new(LINK_WINDOW+2*(QUEUE_DEPTH+1)+RX_RING_SIZE+1, SPI_LINK_MAX_FRAME, &pool);
+    assert(ret==ESP_OK);
+    spi_link_config_t linkcfg=SPI_LINK_DEFAULT_CONFIG(pool);
+    linkcfg.window=LINK_WINDOW;
+    //Acknowledgements come back after the transactions queued on both sides (the sender is supposed to queue as many
+    //as we do)
+    linkcfg.ack_latency=2*QUEUE_DEPTH+2;
+    linkcfg.retx_timeout=4*linkcfg.ack_latency;
+    linkcfg.slave=true;
+#if CONFIG_SPI_COMPRESS
+    linkcfg.unpack=true;
+#endif
+    ret=spi_link_new(&linkcfg, &link);
+    assert(ret==ESP_OK);
+    //The open batch is submitted as soon as the outbound queue is empty, see drain_outbound()
+    spi_link_batch_config_t batchcfg={
+        .link=link,
+        .pool=pool,
+        .deadline_us=0,
+#if CONFIG_SPI_COMPRESS
+        .pack=true,
+#endif
+    };
+    ret=spi_link_batch_new(&batchcfg, &batch);
+    assert(ret==ESP_OK);
+    outbound=xQueueCreate(OUTBOUND_QUEUE_SIZE, sizeof(outbound_msg_t));
+    assert(outbound);
+
+    //Start the consumer of the payloads and the producer of the upstream messages, below us
+    vTaskPrioritySet(NULL, RECEIVER_TASK_PRIORITY);
+    BaseType_t created=xTaskCreate(consumer_task, "consumer", CONSUMER_TASK_STACK, NULL, CONSUMER_TASK_PRIORITY,
+            &consumer);
+    assert(created==pdPASS);
+#if !CONFIG_SPI_BENCHMARK
+    created=xTaskCreate(sensor_task, "sensor", SENSOR_TASK_STACK, NULL, SENSOR_TASK_PRIORITY, NULL);
+    assert(created==pdPASS);
+#endif
+
+    /* Queue all the transactions at once. They are initialized by the SPI master, however, so they will not actually
+    happen until the master starts a hardware transaction by pulling CS low and pulsing the clock etc. The handshake line
+    is pulled by the .post_setup_cb callback as soon as the driver loads a transaction in the hardware, so while there
+    are queued transactions the master is free to transfer data back-to-back.
+    */
+    for (int i=0; i<QUEUE_DEPTH; i++) {
+        queue_trans(&trans[i]);
+    }
+
+    while(1) {
+        //Transactions complete in the order they have been queued
+        spi_slave_transaction_t *done;
+        ret=spi_slave_get_trans_result(RCV_HOST, &done, portMAX_DELAY);
+        assert(ret==ESP_OK);
+        uint8_t *sendbuf=(uint8_t*)done->tx_buffer;
+        uint8_t *recvbuf=done->rx_buffer;
+        spi_link_tx_done(link, sendbuf);
+        //Check the frame first (that's quick), so that the acknowledgements in the new transaction are up to date
+        const uint8_t *payload;
+        size_t len;
+#if CONFIG_SPI_RX_RING_FULL_HOLD
+        //The link stops the sender before the ring is full, and refuses what doesn't fit anyway
+        spi_link_set_rx_room(link, RX_RING_SIZE-rx_ring_count());
+#endif
+        ret=spi_link_process_rx(link, recvbuf, done->trans_len/8, &payload, &len);
+
+        //Hand the messages waiting to go upstream over to the link, now that the acknowledgements may have made room
+        //in the window, then reuse the descriptor for a new transaction, at the end of the queue
+        drain_outbound();
+        queue_trans(done);
+
+        //By here we have sent our data and received data from the master. Leave the payload to the consumer task,
+        //while the master keeps transferring the other queued transactions.
+        if (ret!=ESP_OK) {
+            spi_link_pool_release(pool, recvbuf);
+        } else if (!rx_ring_push(recvbuf, payload, len)) {
+            //The consumer is behind (this can only happen without CONFIG_SPI_RX_RING_FULL_HOLD)
+            rx_dropped++;
+            spi_link_pool_release(pool, recvbuf);
+        }
+    }
+
+}
@@ -0,0 +1,993 @@
+/* SPI Slave example, sender (uses SPI master driver)
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+#include "lwip/netdb.h"
+#include "lwip/igmp.h"
+
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "esp_event.h"
+#include "nvs_flash.h"
+#include "soc/rtc_periph.h"
+#include "driver/spi_master.h"
+#include "esp_log.h"
+#include "esp_spi_flash.h"
+
+#include "driver/gpio.h"
+#include "esp_intr_alloc.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+#include "spi_link.h"
+#include "spi_link_batch.h"
+
+
+/*
+SPI sender (master) example.
+
+This example is supposed to work together with the SPI receiver. It uses the standard SPI pins (MISO, MOSI, SCLK, CS) to
+transmit data over in a full-duplex fashion, that is, while the master puts data on the MOSI pin, the slave puts its own
+data on the MISO pin.
+
+This example uses one extra pin: GPIO_HANDSHAKE is used as a handshake pin. The slave makes this pin high as soon as it is
+ready to receive/send data. This code connects this line to a GPIO interrupt which notifies the main task directly
+(vTaskNotifyGiveFromISR). The notification value counts the edges not consumed yet, one per transaction the slave has
+armed, so none is lost when several come in a row: the main task takes one (ulTaskNotifyTake) before queueing each
+transmission.
+*/
+
+/*
+Transactions are pipelined: instead of blocking in spi_device_transmit, the main task keeps up to PIPELINE_DEPTH
+transactions queued in the driver with spi_device_queue_trans, each one with its own descriptor in a ring. While a
+transaction is clocking out, the next payload is already being prepared, and the results are collected later with
+spi_device_get_trans_result. This way there is no idle gap on the bus between two transactions.
+
+Each transaction carries a frame (see spi_link_frame.h): a header with the payload length, followed by the payload.
+Only header and payload are clocked, so short messages are short on the wire too. Frames are written straight into
+DMA-capable buffers taken from a pool (see spi_link_pool.h), which are handed to the driver as they are and given back
+to the pool when the transaction is done: the driver never needs to copy them.
+
+Frames are numbered and protected by a CRC, and each side acknowledges what it received in its own frames (see
+spi_link.h). Frames that are lost or corrupted are sent again, and duplicates are discarded, so nothing is lost or
+received twice silently.
+
+With CONFIG_SPI_BATCH, messages aren't sent a frame each: they are packed into batches (see spi_link_batch.h), each
+one going out as a single frame when the next message doesn't fit, or when its oldest message has waited
+CONFIG_SPI_BATCH_DEADLINE_US. Small messages then share the handshake, the header and the CRC of a transfer.
+
+The receiver sends its own messages upstream (readings of a sensor), packed into batches as well: they are taken out
+and printed one by one. While it has more waiting, it says so in its frames, and the link makes our transactions long
+enough for a full frame of the receiver, even when we have little to send ourselves.
+
+With CONFIG_SPI_COMPRESS, both sides tell each other in every frame header that they can take compressed batches, and
+the batches sent are compressed when the other side can: each message minus the previous one (delta), run-length
+encoded. Every batch is compressed on its own, so retransmissions work as before.
+
+Every CONFIG_SPI_CONTROL_PERIOD_MS, the sender also sends a short control message, which must get through quickly: it
+goes out on its own, ahead of the payloads waiting. With CONFIG_SPI_FAST_PATH, when it is at most
+CONFIG_SPI_FAST_PATH_MAX_PAYLOAD bytes, it doesn't go through the queue either: once the transactions queued are over,
+it is clocked with spi_device_polling_transmit, which spins until the end of the transaction instead of sleeping
+until its interrupt wakes up the task. The device keeps the bus acquired, so this doesn't have to take it either.
+
+With CONFIG_SPI_BENCHMARK, instead of the messages above, the sender streams patterned payloads of increasing size
+and prints the throughput and the latency of the link for each size. Then it measures the latency of short payloads
+sent one at a time through the queue, and with CONFIG_SPI_FAST_PATH, with the polling driver too.
+*/
+
+
+/*
+Pins in use. The SPI Master can use the GPIO mux, so feel free to change these if needed.
+*/
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 12
+#define GPIO_MISO 13
+#define GPIO_SCLK 15
+#define GPIO_CS 14
+
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define GPIO_HANDSHAKE 8
+#define GPIO_MOSI 7
+#define GPIO_MISO 2
+#define GPIO_SCLK 6
+#define GPIO_CS 10
+
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 11
+#define GPIO_MISO 13
+#define GPIO_SCLK 12
+#define GPIO_CS 10
+
+#endif //CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+
+
+#ifdef CONFIG_IDF_TARGET_ESP32
+#define SENDER_HOST HSPI_HOST
+
+#else
+#define SENDER_HOST SPI2_HOST
+
+#endif
+
+
+//Transactions that can be queued in the SPI driver at the same time
+#define PIPELINE_DEPTH CONFIG_SPI_PIPELINE_DEPTH
+//Room for the copy of the last payload received, that is sent back
+#define LASTRECV_SIZE 128
+
+static spi_device_handle_t handle;
+static int clock_hz;    //Current SPI clock frequency
+
+//Ring of transaction descriptors, which must stay untouched while they are queued
+static spi_transaction_t trans[PIPELINE_DEPTH];
+static int queued=0;    //Transactions queued in the driver whose result hasn't been collected yet
+static int next=0;      //Slot of the ring for the next transaction
+
+//Frames sent and not acknowledged yet, at most
+#define LINK_WINDOW 8
+
+//Frame buffers: the window, plus one to send and one to receive for each queued transaction, plus the open batch
+static spi_link_pool_t *pool;
+static spi_link_t *link;
+#if CONFIG_SPI_BATCH
+static spi_link_batch_t *batch;
+#define POOL_SIZE (LINK_WINDOW+2*PIPELINE_DEPTH+1)
+#else
+#define POOL_SIZE (LINK_WINDOW+2*PIPELINE_DEPTH)
+#endif
+
+//The task notified by the handshake ISR: its notification value counts the edges telling the slave is ready
+static TaskHandle_t link_task;
+
+//Handshake edges, in the order they came. The ISR writes edge edges_seen, the task reads edge edges_taken.
+//There can't be more edges pending than transactions queued in the slave.
+#define EDGE_RING 16
+typedef struct {
+    uint32_t ccount;        //CPU cycle counter
+#if CONFIG_SPI_BENCHMARK
+    int64_t us;             //esp_timer time
+#endif
+} edge_t;
+static edge_t edges[EDGE_RING];
+static volatile uint32_t edges_seen=0;
+static uint32_t edges_taken=0;
+
+//Edges closer than this to the previous one are glitches, in CPU cycles, and how many of them have been ignored
+static uint32_t filter_cycles;
+static volatile uint32_t edges_rejected=0;
+
+//Time from the ISR to the main task running, when it had to wait for the edge, in CPU cycles
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} wake_stats_t;
+static wake_stats_t wake;
+
+#if CONFIG_SPI_BENCHMARK
+//When each slot of the ring got its handshake and was done
+static int64_t handshake_us[PIPELINE_DEPTH];
+static int64_t done_us[PIPELINE_DEPTH];
+#endif
+
+static void IRAM_ATTR record_edge(uint32_t ccount)
+{
+    edge_t *e=&edges[edges_seen%EDGE_RING];
+    e->ccount=ccount;
+#if CONFIG_SPI_BENCHMARK
+    e->us=esp_timer_get_time();
+#endif
+    edges_seen++;
+}
+
+/*
+This ISR is called when the handshake line goes low.
+*/
+static void IRAM_ATTR gpio_handshake_isr_handler(void* arg)
+{
+    //Sometimes due to interference or ringing or something, we get two irqs after eachother. The slave can't arm two
+    //transactions faster than one of the shortest transactions, so only an edge closer than that to the previous one
+    //is ignored: the original 1 ms also dropped the real ones.
+    uint32_t now=esp_cpu_get_ccount();
+    if (now-edges[(edges_seen-1)%EDGE_RING].ccount<filter_cycles) {
+        edges_rejected++;
+        return;
+    }
+    record_edge(now);
+    //Notify the main task: the notification value works as a counting semaphore, without a queue behind it
+    BaseType_t mustYield=false;
+    vTaskNotifyGiveFromISR(link_task, &mustYield);
+    if (mustYield) portYIELD_FROM_ISR();
+}
+
+//Wait until the slave is ready for the next transaction, and return the handshake edge telling so
+static const edge_t *wait_handshake(void)
+{
+    if (ulTaskNotifyTake(pdFALSE, 0)==0) {
+        //Nothing pending: block, and measure how long it takes to get here from the ISR
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+        uint32_t cycles=esp_cpu_get_ccount()-edges[(edges_seen-1)%EDGE_RING].ccount;
+        if (wake.count==0 || cycles<wake.min) wake.min=cycles;
+        if (cycles>wake.max) wake.max=cycles;
+        wake.sum+=cycles;
+        wake.count++;
+    }
+    return &edges[edges_taken++%EDGE_RING];
+}
+
+static void print_handshake_stats(void)
+{
+    printf("Handshake edges: %u accepted, %u rejected as glitches\n", (unsigned)edges_seen, (unsigned)edges_rejected);
+    if (wake.count==0) {
+        return;
+    }
+    uint32_t per_us=esp_rom_get_cpu_ticks_per_us();
+    printf("Handshake ISR to task: %u wake-ups, min %u, avg %u, max %u cycles (%u cycles/us)\n",
+            (unsigned)wake.count, (unsigned)wake.min, (unsigned)(wake.sum/wake.count), (unsigned)wake.max,
+            (unsigned)per_us);
+    memset(&wake, 0, sizeof(wake));
+}
+
+#if CONFIG_SPI_BENCHMARK
+//Called by the driver (in the ISR) when a transaction is done
+static void IRAM_ATTR spi_post_cb(spi_transaction_t *t)
+{
+    done_us[(int)(intptr_t)t->user]=esp_timer_get_time();
+}
+#endif
+
+//Latency histogram: bucket k counts the latencies in [2^k, 2^(k+1)) us
+#define LATENCY_BUCKETS 20
+
+typedef struct {
+    uint32_t count;
+    int64_t min_us;
+    int64_t max_us;
+    int64_t sum_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_stats_t;
+
+#if CONFIG_SPI_BENCHMARK
+static latency_stats_t latency;
+#endif
+
+static void latency_add(latency_stats_t *l, int64_t us)
+{
+    int k=0;
+    while (k<LATENCY_BUCKETS-1 && us>=(2LL<<k)) {
+        k++;
+    }
+    l->buckets[k]++;
+    if (l->count==0 || us<l->min_us) l->min_us=us;
+    if (l->count==0 || us>l->max_us) l->max_us=us;
+    l->sum_us+=us;
+    l->count++;
+}
+
+//Upper bound of the bucket where the percentile falls, but never outside of the latencies actually measured: the
+//bucket of the largest one usually goes well past it
+static int64_t latency_percentile(const latency_stats_t *l, int percent)
+{
+    uint32_t seen=0;
+    for (int k=0; k<LATENCY_BUCKETS; k++) {
+        seen+=l->buckets[k];
+        if (seen*100>=l->count*(uint32_t)percent) {
+            int64_t bound=2LL<<k;
+            if (bound>l->max_us) return l->max_us;
+            if (bound<l->min_us) return l->min_us;
+            return bound;
+        }
+    }
+    return l->max_us;
+}
+
+#if CONFIG_SPI_COMPRESS
+//Room for a compressed batch of the receiver, once decoded
+static uint8_t unpack_buf[SPI_LINK_MAX_PAYLOAD];
+#endif
+
+//Pass the messages of a payload received to on_receive: one, or all those of a batch of the receiver
+static void deliver(const uint8_t *frame, const uint8_t *payload, size_t len,
+        void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    if (!(spi_link_frame_header(frame)->flags&SPI_LINK_FLAG_BATCH)) {
+        on_receive(payload, len);
+        return;
+    }
+    const uint8_t *msg;
+    size_t msg_len;
+    esp_err_t ret=ESP_OK;
+#if CONFIG_SPI_COMPRESS
+    ret=spi_link_batch_unpack(&payload, &len, unpack_buf, sizeof(unpack_buf));
+#endif
+    while (ret==ESP_OK && (ret=spi_link_batch_next(&payload, &len, &msg, &msg_len))==ESP_OK) {
+        on_receive(msg, msg_len);
+    }
+    if (ret!=ESP_ERR_NOT_FOUND) {
+        printf("Malformed batch: %s\n", esp_err_to_name(ret));
+    }
+}
+
+//Hand a transaction that is done back to the link, and pass the payload received to on_receive
+static void finish_transfer(spi_transaction_t *done, void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    spi_link_tx_done(link, (uint8_t*)done->tx_buffer);
+    //The slave answers in the same transfer, so its frame is cut if it is longer than ours: the link makes the next
+    //transfers longer, and the slave sends it again. While the slave says it has more to send, the link makes them
+    //long enough for a full frame right away.
+    const uint8_t *rx_payload;
+    size_t rx_len;
+    esp_err_t ret=spi_link_process_rx(link, done->rx_buffer, done->length/8, &rx_payload, &rx_len);
+    if (ret==ESP_OK && on_receive) {
+        deliver(done->rx_buffer, rx_payload, rx_len, on_receive);
+    }
+    spi_link_pool_release(pool, done->rx_buffer);
+}
+
+//Collect the transactions that are done, and pass the payloads received to on_receive. Unless all is set, only the
+//ones that are already done are collected, without waiting: when the ring is full, the next slot is still queued, so
+//wait for it (transactions complete in order, the oldest one is exactly that slot).
+static void collect_transfers(void (*on_receive)(const uint8_t *payload, size_t len), bool all)
+{
+    spi_transaction_t *done;
+    while (queued>0 && spi_device_get_trans_result(handle, &done,
+            (all || queued==PIPELINE_DEPTH) ? portMAX_DELAY : 0)==ESP_OK) {
+        queued--;
+#if CONFIG_SPI_BENCHMARK
+        int slot=(int)(intptr_t)done->user;
+        latency_add(&latency, done_us[slot]-handshake_us[slot]);
+#endif
+        finish_transfer(done, on_receive);
+    }
+}
+
+#if CONFIG_SPI_CLOCK_TRAINING
+static void train(void);
+
+#if CONFIG_SPI_RETRAIN_ERROR_PERCENT
+//Transfers over which the error rate is measured
+#define RETRAIN_PERIOD 1000
+
+//Train the link again if too many transfers have been corrupted lately, in either direction: corrupted frames of the
+//slave fail their CRC here, ours are reported back and retransmitted
+static void check_error_rate(void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    static uint32_t transfers=0;
+    static uint32_t errors_before=0;
+    if (++transfers<RETRAIN_PERIOD) {
+        return;
+    }
+    spi_link_stats_t stats;
+    spi_link_get_stats(link, &stats);
+    uint32_t errors=stats.rx_crc_errors+stats.tx_retransmits;
+    if ((errors-errors_before)*100>transfers*CONFIG_SPI_RETRAIN_ERROR_PERCENT) {
+        printf("Training: %u errors in the last %u transfers\n", (unsigned)(errors-errors_before), (unsigned)transfers);
+        //The clock can be changed only with no transaction queued
+        collect_transfers(on_receive, true);
+        train();
+        //Don't count the errors made during the training
+        spi_link_get_stats(link, &stats);
+        errors=stats.rx_crc_errors+stats.tx_retransmits;
+    }
+    transfers=0;
+    errors_before=errors;
+}
+#endif
+#endif
+
+//Queue the next frame of the link, then collect the transactions that are done and pass the payloads received to
+//on_receive
+static void link_transfer(void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    esp_err_t ret;
+    spi_transaction_t *t=&trans[next];
+    //The frame to send: one that got lost, a new one, or just the acknowledgements. There are always buffers for
+    //a new transaction: no more than PIPELINE_DEPTH-1 are still queued here.
+    size_t size;
+    uint8_t *sendbuf=spi_link_prepare_tx(link, &size);
+    uint8_t *recvbuf=spi_link_pool_acquire(pool, portMAX_DELAY);
+    memset(t, 0, sizeof(*t));
+    t->length=size*8;
+    t->tx_buffer=sendbuf;
+    t->rx_buffer=recvbuf;
+    t->user=(void*)(intptr_t)next;
+    //Wait for slave to be ready for next byte before sending
+    const edge_t *edge=wait_handshake();
+#if CONFIG_SPI_BENCHMARK
+    handshake_us[next]=edge->us;
+#else
+    (void)edge;
+#endif
+    ret=spi_device_queue_trans(handle, t, portMAX_DELAY);
+    assert(ret==ESP_OK);
+    queued++;
+    next=(next+1)%PIPELINE_DEPTH;
+
+    collect_transfers(on_receive, false);
+#if CONFIG_SPI_CLOCK_TRAINING && CONFIG_SPI_RETRAIN_ERROR_PERCENT
+    check_error_rate(on_receive);
+#endif
+}
+
+//Send a short payload through the queue, ahead of the ones not sent yet, and wait for the transaction carrying it.
+//Returns how long it took, in us.
+static int64_t send_queued(const void *msg, size_t len, void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    int64_t start=esp_timer_get_time();
+    while (!spi_link_can_submit(link)) {
+        link_transfer(on_receive);
+    }
+    uint8_t *frame=spi_link_pool_acquire(pool, portMAX_DELAY);
+    memcpy(spi_link_frame_payload(frame), msg, len);
+    esp_err_t ret=spi_link_submit_urgent(link, frame, len);
+    assert(ret==ESP_OK);
+    //It goes out in the next transaction, unless the receiver is busy
+    do {
+        link_transfer(on_receive);
+    } while (trans[(next+PIPELINE_DEPTH-1)%PIPELINE_DEPTH].tx_buffer!=frame);
+    collect_transfers(on_receive, true);
+    return esp_timer_get_time()-start;
+}
+
+#if CONFIG_SPI_FAST_PATH
+//Prepare the next frame of the link and clock it right away, then pass the payload received to on_receive. Returns
+//the frame sent. No transaction may be queued.
+static const uint8_t *polled_transfer(void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    size_t size;
+    uint8_t *sendbuf=spi_link_prepare_tx(link, &size);
+    uint8_t *recvbuf=spi_link_pool_acquire(pool, portMAX_DELAY);
+    spi_transaction_t t={
+        .length=size*8,
+        .tx_buffer=sendbuf,
+        .rx_buffer=recvbuf,
+    };
+    wait_handshake();
+    //The task spins until the end of the transaction, instead of sleeping until its interrupt wakes it up. The bus
+    //is ours already (see set_clock), so it doesn't have to be taken either.
+    esp_err_t ret=spi_device_polling_transmit(handle, &t);
+    assert(ret==ESP_OK);
+    finish_transfer(&t, on_receive);
+    return sendbuf;
+}
+
+//Send a short payload on its own, with the polling driver: the transactions queued are let finish first, then it
+//takes a single transaction. Returns how long it took, in us.
+static int64_t send_polled(const void *msg, size_t len, void (*on_receive)(const uint8_t *payload, size_t len))
+{
+    int64_t start=esp_timer_get_time();
+    collect_transfers(on_receive, true);
+    while (!spi_link_can_submit(link)) {
+        polled_transfer(on_receive);
+    }
+    uint8_t *frame=spi_link_pool_acquire(pool, portMAX_DELAY);
+    memcpy(spi_link_frame_payload(frame), msg, len);
+    esp_err_t ret=spi_link_submit_urgent(link, frame, len);
+    assert(ret==ESP_OK);
+    //It goes out in the next transaction, unless the receiver is busy
+    while (polled_transfer(on_receive)!=frame) {
+    }
+    return esp_timer_get_time()-start;
+}
+#endif
+
+#if !CONFIG_SPI_BENCHMARK
+//Latency of the control messages since the start, from the moment they are made to the end of the transaction
+//carrying them
+static latency_stats_t polled_latency;
+static latency_stats_t queued_latency;
+
+//Send a control message: on its own with the polling driver if it is short enough, otherwise through the queue, but
+//ahead of the payloads waiting there. Bulk data keeps going through the queue and the batches.
+static void send_control(const char *msg, size_t len, void (*on_receive)(const uint8_t *payload, size_t len))
+{
+#if CONFIG_SPI_FAST_PATH
+    if (len<=CONFIG_SPI_FAST_PATH_MAX_PAYLOAD) {
+        latency_add(&polled_latency, send_polled(msg, len, on_receive));
+        return;
+    }
+#endif
+    latency_add(&queued_latency, send_queued(msg, len, on_receive));
+}
+
+static void print_control_latency(const char *path, latency_stats_t *l)
+{
+    if (l->count==0) {
+        return;
+    }
+    //The percentile is the bound of a power-of-two bucket: 99% of the latencies are within it, it isn't exact
+    printf("Control: %u messages %s, latency min %u, avg %u, 99%% within %u, max %u us\n", (unsigned)l->count, path,
+            (unsigned)l->min_us, (unsigned)(l->sum_us/l->count), (unsigned)latency_percentile(l, 99),
+            (unsigned)l->max_us);
+}
+#endif
+
+static void print_link_stats(void)
+{
+    spi_link_stats_t stats;
+    spi_link_get_stats(link, &stats);
+    printf("Link: %u frames sent, %u retransmitted, %u received, %u duplicates, %u CRC errors, %u truncated\n",
+            (unsigned)stats.tx_frames, (unsigned)stats.tx_retransmits, (unsigned)stats.rx_frames,
+            (unsigned)stats.rx_duplicates, (unsigned)stats.rx_crc_errors, (unsigned)stats.rx_truncated);
+    printf("Link: %u transfers without payload while the receiver was busy, %u stretched for its data\n",
+            (unsigned)stats.tx_held, (unsigned)stats.tx_stretched);
+#if CONFIG_SPI_BATCH
+    spi_link_batch_stats_t bstats;
+    spi_link_batch_get_stats(batch, &bstats);
+    printf("Batches: %u sent with %u messages, %u full, %u at the deadline, %u flushed\n",
+            (unsigned)bstats.batches, (unsigned)bstats.messages, (unsigned)bstats.full, (unsigned)bstats.deadline,
+            (unsigned)bstats.flushed);
+#if CONFIG_SPI_COMPRESS
+    printf("Batches: %u compressed, %llu bytes sent as %llu\n", (unsigned)bstats.packed,
+            (unsigned long long)bstats.raw_bytes, (unsigned long long)bstats.sent_bytes);
+#endif
+#endif
+#if !CONFIG_SPI_BENCHMARK
+    print_control_latency("polled", &polled_latency);
+    print_control_latency("queued", &queued_latency);
+#endif
+    print_handshake_stats();
+}
+
+//Configuration for the SPI device on the other side of the bus
+static spi_device_interface_config_t devcfg={
+    .command_bits=0,
+    .address_bits=0,
+    .dummy_bits=0,
+    .duty_cycle_pos=128,        //50% duty cycle
+    .mode=0,
+    .spics_io_num=GPIO_CS,
+    .cs_ena_posttrans=3,        //Keep the CS low 3 cycles after transaction, to stop slave from missing the last bit when CS has less propagation delay than CLK
+    .queue_size=PIPELINE_DEPTH,
+#if CONFIG_SPI_BENCHMARK
+    .post_cb=spi_post_cb,
+#endif
+};
+
+//Add the device we want to send stuff to, with the given clock. The driver can't change the clock of a device, so
+//it is removed and added again: no transaction may be queued.
+static void set_clock(int hz)
+{
+    esp_err_t ret;
+    if (handle) {
+#if CONFIG_SPI_FAST_PATH
+        spi_device_release_bus(handle);
+#endif
+        ret=spi_bus_remove_device(handle);
+        assert(ret==ESP_OK);
+    }
+    devcfg.clock_speed_hz=hz;
+    ret=spi_bus_add_device(SENDER_HOST, &devcfg, &handle);
+    assert(ret==ESP_OK);
+#if CONFIG_SPI_FAST_PATH
+    //Nobody else is on the bus: keep it, so that a polling transaction doesn't have to wait to take it
+    ret=spi_device_acquire_bus(handle, portMAX_DELAY);
+    assert(ret==ESP_OK);
+#endif
+    clock_hz=hz;
+
+    //The shortest transaction clocks just a frame header: this is how close two real handshake edges can be, at most
+    uint64_t min_period_cycles=(uint64_t)SPI_LINK_HEADER_SIZE*8*esp_rom_get_cpu_ticks_per_us()*1000000/hz;
+    filter_cycles=min_period_cycles*CONFIG_SPI_HANDSHAKE_FILTER_PERCENT/100;
+}
+
+#if CONFIG_SPI_CLOCK_TRAINING
+//Clock frequencies tried by the training after CONFIG_SPI_CLOCK_HZ, in increasing order: the ones the SPI peripheral
+//can generate from the 80 MHz APB clock without jitter (80 MHz divided by an integer)
+static const int train_clocks[]={8000000, 10000000, 13333333, 16000000, 20000000, 26666666, 40000000};
+#define TRAIN_CLOCK_NUM (sizeof(train_clocks)/sizeof(train_clocks[0]))
+//Test frames sent at each frequency: all of them must come back intact
+#define TRAIN_FRAMES 64
+//The echo of a test frame comes back in the transaction the slave arms after receiving it, behind the ones it has
+//queued already (the receiver is supposed to queue as many as we do)
+#define TRAIN_FLUSH (PIPELINE_DEPTH+1)
+
+static uint16_t train_seq=0;
+
+//Byte i of test frame seq. Each frame stresses the wires in a different way: fastest toggling, long runs, a single
+//bit moving around, and noise.
+static uint8_t train_byte(uint16_t seq, size_t i)
+{
+    switch (seq%4) {
+    case 0: return (i&1) ? 0xAA : 0x55;
+    case 1: return (i&4) ? 0xFF : 0x00;
+    case 2: return 1<<(i%8);
+    default: return (uint8_t)(((i+1)*2654435761u ^ seq*40503u)>>13);
+    }
+}
+
+//Send TRAIN_FRAMES test frames of the largest size at the given clock, and check that all of them come back intact
+static bool train_at(int hz)
+{
+    esp_err_t ret;
+    set_clock(hz);
+    uint8_t *sendbuf=spi_link_pool_acquire(pool, portMAX_DELAY);
+    uint8_t *recvbuf=spi_link_pool_acquire(pool, portMAX_DELAY);
+    uint16_t first=train_seq;
+    uint64_t echoed=0;      //bit i: echo of test frame first+i received intact
+    for (int n=0; n<TRAIN_FRAMES+TRAIN_FLUSH; n++) {
+        spi_link_header_t header={
+            .flags=SPI_LINK_FLAG_TEST,
+            .len=SPI_LINK_MAX_PAYLOAD,
+            .seq=train_seq++,
+        };
+        uint8_t *payload=spi_link_frame_payload(sendbuf);
+        for (size_t i=0; i<header.len; i++) {
+            payload[i]=train_byte(header.seq, i);
+        }
+        spi_transaction_t t={
+            .length=spi_link_frame_finish(sendbuf, &header)*8,
+            .tx_buffer=sendbuf,
+            .rx_buffer=recvbuf,
+        };
+        //One transaction at a time: no need to be fast here
+        wait_handshake();
+        ret=spi_device_transmit(handle, &t);
+        assert(ret==ESP_OK);
+
+        const spi_link_header_t *echo;
+        const uint8_t *echo_payload;
+        if (spi_link_frame_parse(recvbuf, t.length/8, &echo, &echo_payload)!=ESP_OK ||
+                !(echo->flags&SPI_LINK_FLAG_ECHO) || (uint16_t)(echo->seq-first)>=TRAIN_FRAMES ||
+                echo->len!=SPI_LINK_MAX_PAYLOAD) {
+            continue;
+        }
+        size_t i=0;
+        while (i<echo->len && echo_payload[i]==train_byte(echo->seq, i)) {
+            i++;
+        }
+        if (i==echo->len) {
+            echoed|=1ULL<<(uint16_t)(echo->seq-first);
+        }
+    }
+    spi_link_pool_release(pool, sendbuf);
+    spi_link_pool_release(pool, recvbuf);
+    return echoed==(TRAIN_FRAMES==64 ? ~0ULL : (1ULL<<TRAIN_FRAMES)-1);
+}
+
+//Step up the clock until the test frames don't come back intact, then settle CONFIG_SPI_TRAINING_MARGIN_STEPS steps
+//below the highest frequency that passed. No transaction may be queued.
+static void train(void)
+{
+    int clocks[1+TRAIN_CLOCK_NUM];
+    int clock_num=0;
+    clocks[clock_num++]=CONFIG_SPI_CLOCK_HZ;
+    for (int i=0; i<TRAIN_CLOCK_NUM; i++) {
+        if (train_clocks[i]>CONFIG_SPI_CLOCK_HZ && train_clocks[i]<=CONFIG_SPI_CLOCK_MAX_HZ) {
+            clocks[clock_num++]=train_clocks[i];
+        }
+    }
+    int passed=-1;
+    for (int i=0; i<clock_num; i++) {
+        bool ok=train_at(clocks[i]);
+        printf("Training: %d Hz %s\n", clocks[i], ok ? "passed" : "failed");
+        if (!ok) {
+            break;
+        }
+        passed=i;
+    }
+    int chosen=passed-CONFIG_SPI_TRAINING_MARGIN_STEPS;
+    if (chosen<0) {
+        chosen=0;
+    }
+    set_clock(clocks[chosen]);
+    printf("Training: running at %d Hz%s\n", clock_hz, passed<0 ? ", even if it failed" : "");
+}
+#endif
+
+#if CONFIG_SPI_BENCHMARK
+//Payload number n: the number, then bytes counting up from it. The receiver checks it.
+static void fill_pattern(uint8_t *payload, size_t len, uint32_t n)
+{
+    for (size_t i=0; i<len; i++) {
+        payload[i]=i<4 ? (uint8_t)(n>>(8*i)) : (uint8_t)(n+i);
+    }
+}
+
+#if CONFIG_SPI_BATCH
+//Room for a message of the batched rows, which is copied into the batch
+static uint8_t bench_msg[SPI_LINK_BATCH_MAX_MESSAGE];
+#endif
+
+//Stream payloads of the given size for CONFIG_SPI_BENCHMARK_DURATION_MS, then wait until all of them are
+//acknowledged, and print a row of the summary table. With batched, the payloads are messages packed into batches, and
+//they are made as fast as the batches can take them.
+static void benchmark_size(size_t size, bool batched)
+{
+    memset(&latency, 0, sizeof(latency));
+    memset(&wake, 0, sizeof(wake));
+    spi_link_stats_t before, after;
+    spi_link_get_stats(link, &before);
+#if CONFIG_SPI_BATCH
+    spi_link_batch_stats_t bbefore, bafter;
+    spi_link_batch_get_stats(batch, &bbefore);
+#endif
+    uint32_t payloads=0, transfers=0;
+    int64_t start=esp_timer_get_time();
+    int64_t end=start+CONFIG_SPI_BENCHMARK_DURATION_MS*1000LL;
+    while (1) {
+        bool producing=esp_timer_get_time()<end;
+#if CONFIG_SPI_BATCH
+        if (batched) {
+            //Stops when the batch is full and the window too
+            while (producing) {
+                fill_pattern(bench_msg, size, payloads);
+                if (spi_link_batch_add(batch, bench_msg, size)!=ESP_OK) {
+                    break;
+                }
+                payloads++;
+            }
+            if (producing) {
+                spi_link_batch_poll(batch);
+            } else {
+                spi_link_batch_flush(batch);
+            }
+        }
+        if (!producing && !spi_link_batch_pending(batch) && !spi_link_has_pending(link)) {
+            break;
+        }
+#else
+        if (!producing && !spi_link_has_pending(link)) {
+            break;
+        }
+#endif
+        if (!batched && producing && spi_link_can_submit(link)) {
+            uint8_t *frame=spi_link_pool_acquire(pool, portMAX_DELAY);
+            fill_pattern(spi_link_frame_payload(frame), size, payloads);
+            esp_err_t ret=spi_link_submit(link, frame, size);
+            assert(ret==ESP_OK);
+            payloads++;
+        }
+        link_transfer(NULL);
+        transfers++;
+    }
+    int64_t elapsed_us=esp_timer_get_time()-start;
+    spi_link_get_stats(link, &after);
+    //Payloads per frame, in tenths
+    uint32_t per_frame=10;
+#if CONFIG_SPI_BATCH
+    spi_link_batch_get_stats(batch, &bafter);
+    if (batched && bafter.batches>bbefore.batches) {
+        per_frame=(bafter.messages-bbefore.messages)*10/(bafter.batches-bbefore.batches);
+    }
+#endif
+    printf("%8u | %3u.%u | %10u | %12u | %6u | %7u | %7u | %7u | %7u\n", (unsigned)size,
+            (unsigned)(per_frame/10), (unsigned)(per_frame%10),
+            (unsigned)(payloads*1000000LL/elapsed_us), (unsigned)(payloads*(int64_t)size*1000000LL/elapsed_us),
+            (unsigned)(transfers*1000000LL/elapsed_us), (unsigned)(after.tx_retransmits-before.tx_retransmits),
+            (unsigned)latency.min_us, (unsigned)latency_percentile(&latency, 50), (unsigned)latency_percentile(&latency, 99));
+    printf("         |       |            |              |        |         | avg %3u | max %7u | wake %u/%u/%u cycles\n",
+            (unsigned)(latency.count ? latency.sum_us/latency.count : 0), (unsigned)latency.max_us,
+            (unsigned)wake.min, (unsigned)(wake.count ? wake.sum/wake.count : 0), (unsigned)wake.max);
+}
+
+//Payloads sent through each path by benchmark_paths(), and their size: as long as a control message
+#define PATH_SAMPLES 500
+#define PATH_PAYLOAD 16
+
+static void print_path_latency(const char *path, const latency_stats_t *l)
+{
+    printf("%8s | %7u | %7u | %7u | %7u | %7u\n", path, (unsigned)l->min_us,
+            (unsigned)(l->count ? l->sum_us/l->count : 0), (unsigned)latency_percentile(l, 50),
+            (unsigned)latency_percentile(l, 99), (unsigned)l->max_us);
+}
+
+//Send short payloads one at a time, through the queue and (with CONFIG_SPI_FAST_PATH) with the polling driver in
+//turn, and print how long they take from the call to the end of their transaction
+static void benchmark_paths(void)
+{
+    uint8_t msg[PATH_PAYLOAD];
+    latency_stats_t queued_lat={0};
+#if CONFIG_SPI_FAST_PATH
+    latency_stats_t polled_lat={0};
+#endif
+    uint32_t n=0;
+    for (int i=0; i<PATH_SAMPLES; i++) {
+        fill_pattern(msg, sizeof(msg), n++);
+        latency_add(&queued_lat, send_queued(msg, sizeof(msg), NULL));
+#if CONFIG_SPI_FAST_PATH
+        fill_pattern(msg, sizeof(msg), n++);
+        latency_add(&polled_lat, send_polled(msg, sizeof(msg), NULL));
+#endif
+    }
+    printf("Paths: %d byte payloads, one at a time, from the call to the end of their transaction, in us "
+            "(percentiles are bucket bounds, up to the max)\n", PATH_PAYLOAD);
+    printf("    path | lat min | lat avg | lat p50 | lat p99 | lat max\n");
+    print_path_latency("queued", &queued_lat);
+#if CONFIG_SPI_FAST_PATH
+    print_path_latency("polled", &polled_lat);
+#endif
+}
+
+static void run_benchmark(void)
+{
+    printf("Benchmark: SPI clock %d Hz, %d transactions queued, window of %d frames, %d ms per size\n",
+            clock_hz, PIPELINE_DEPTH, LINK_WINDOW, CONFIG_SPI_BENCHMARK_DURATION_MS);
+    printf("Latency: from the handshake edge to the end of the transaction, in us "
+            "(percentiles are bucket bounds, up to the max)\n");
+    printf("Wake: from the handshake ISR to the task waiting for it, min/avg/max in CPU cycles (%u per us)\n",
+            (unsigned)esp_rom_get_cpu_ticks_per_us());
+    printf("Batch: payloads per frame, on the rows where the payloads are batched messages\n");
+    printf(" payload | batch | payloads/s | payload B/s  | xfer/s | retrans | lat min | lat p50 | lat p99\n");
+    size_t size=CONFIG_SPI_BENCHMARK_MIN_PAYLOAD;
+    while (1) {
+        benchmark_size(size, false);
+#if CONFIG_SPI_BATCH
+        //Only if at least two of them fit in a batch
+        if (2*(SPI_LINK_BATCH_PREFIX_SIZE+size)<=SPI_LINK_MAX_PAYLOAD) {
+            benchmark_size(size, true);
+        }
+#endif
+        if (size>=CONFIG_SPI_BENCHMARK_MAX_PAYLOAD) {
+            break;
+        }
+        size=size*4<CONFIG_SPI_BENCHMARK_MAX_PAYLOAD ? size*4 : CONFIG_SPI_BENCHMARK_MAX_PAYLOAD;
+    }
+    benchmark_paths();
+    print_link_stats();
+}
+#else
+static char lastrecv[LASTRECV_SIZE];
+
+static void print_received(const uint8_t *payload, size_t len)
+{
+    printf("Received: %.*s\n", (int)len, (const char*)payload);
+    snprintf(lastrecv, sizeof(lastrecv), "%.*s", (int)len, (const char*)payload);
+}
+#endif
+
+//Main application
+void app_main(void)
+{
+    esp_err_t ret;
+
+    //Configuration for the SPI bus
+    spi_bus_config_t buscfg={
+        .mosi_io_num=GPIO_MOSI,
+        .miso_io_num=GPIO_MISO,
+        .sclk_io_num=GPIO_SCLK,
+        .quadwp_io_num=-1,
+        .quadhd_io_num=-1,
+        .max_transfer_sz=SPI_LINK_MAX_FRAME
+    };
+
+    //GPIO config for the handshake line.
+    gpio_config_t io_conf={
+        .intr_type=GPIO_INTR_NEGEDGE,
+        .mode=GPIO_MODE_INPUT,
+        .pull_up_en=1,
+        .pin_bit_mask=(1<<GPIO_HANDSHAKE)
+    };
+
+    //Allocate the frame buffers and set up our end of the link. Acknowledgements come back after the transactions
+    //queued on both sides (the receiver is supposed to queue as many as we do).
+    ret=spi_link_pool_new(POOL_SIZE, SPI_LINK_MAX_FRAME, &pool);
+    assert(ret==ESP_OK);
+    spi_link_config_t linkcfg=SPI_LINK_DEFAULT_CONFIG(pool);
+    linkcfg.window=LINK_WINDOW;
+    linkcfg.ack_latency=2*PIPELINE_DEPTH+2;
+    linkcfg.retx_timeout=4*linkcfg.ack_latency;
+#if CONFIG_SPI_COMPRESS
+    linkcfg.unpack=true;
+#endif
+    ret=spi_link_new(&linkcfg, &link);
+    assert(ret==ESP_OK);
+#if CONFIG_SPI_BATCH
+    spi_link_batch_config_t batchcfg={
+        .link=link,
+        .pool=pool,
+        .deadline_us=CONFIG_SPI_BATCH_DEADLINE_US,
+#if CONFIG_SPI_COMPRESS
+        .pack=true,
+#endif
+    };
+    ret=spi_link_batch_new(&batchcfg, &batch);
+    assert(ret==ESP_OK);
+#endif
+
+    //Assume the slave is ready for the first transmission: if the slave started up before us, we will not detect
+    //the edge on the handshake line. The ISR isn't installed yet, so we can record the edge ourselves.
+    link_task=xTaskGetCurrentTaskHandle();
+    record_edge(esp_cpu_get_ccount());
+    xTaskNotifyGive(link_task);
+
+    //Set up handshake line interrupt.
+    gpio_config(&io_conf);
+    gpio_install_isr_service(0);
+    gpio_set_intr_type(GPIO_HANDSHAKE, GPIO_INTR_NEGEDGE);
+    gpio_isr_handler_add(GPIO_HANDSHAKE, gpio_handshake_isr_handler, NULL);
+
+    //Initialize the SPI bus and add the device we want to send stuff to.
+    ret=spi_bus_initialize(SENDER_HOST, &buscfg, SPI_DMA_CH_AUTO);
+    assert(ret==ESP_OK);
+    set_clock(CONFIG_SPI_CLOCK_HZ);
+#if CONFIG_SPI_CLOCK_TRAINING
+    //Find out how fast this pair of boards can go
+    train();
+#endif
+
+#if CONFIG_SPI_BENCHMARK
+    run_benchmark();
+    //Keep acknowledging what the receiver sends
+    while(1) {
+        link_transfer(NULL);
+    }
+#else
+    int n=0;
+    int control_n=0;
+    int64_t next_control=esp_timer_get_time();
+    while(1) {
+        //Every CONFIG_SPI_CONTROL_PERIOD_MS, a short control message that can't wait behind the bulk data
+        if (esp_timer_get_time()>=next_control) {
+            char control[32];
+            int len=snprintf(control, sizeof(control), "Control no. %04i", control_n++);
+            send_control(control, len, print_received);
+            next_control=esp_timer_get_time()+CONFIG_SPI_CONTROL_PERIOD_MS*1000LL;
+        }
+#if CONFIG_SPI_BATCH
+        //Add the next message to the open batch, while the previous transactions are clocking out, unless the batch
+        //is full and the frames sent before haven't been acknowledged yet
+        char msg[LASTRECV_SIZE+64];
+        int res = snprintf(msg, sizeof(msg),
+                "Sender, transmission no. %04i. Last time, I received: \"%s\"", n, lastrecv);
+        if (res >= sizeof(msg)) {
+            printf("Data truncated\n");
+            res=sizeof(msg)-1;
+        }
+        if (spi_link_batch_add(batch, msg, res)==ESP_OK) {
+            n++;
+            if (n%1000==0) {
+                print_link_stats();
+            }
+        }
+        //Send the batch if its first message has waited long enough
+        spi_link_batch_poll(batch);
+#else
+        //Prepare the next payload, while the previous transactions are clocking out, unless the frames sent before
+        //haven't been acknowledged yet
+        if (spi_link_can_submit(link)) {
+            uint8_t *frame=spi_link_pool_acquire(pool, portMAX_DELAY);
+            char *payload=(char*)spi_link_frame_payload(frame);
+            int res = snprintf(payload, SPI_LINK_MAX_PAYLOAD,
+                    "Sender, transmission no. %04i. Last time, I received: \"%s\"", n, lastrecv);
+            if (res >= SPI_LINK_MAX_PAYLOAD) {
+                printf("Data truncated\n");
+                res=SPI_LINK_MAX_PAYLOAD-1;
+            }
+            //The terminator isn't sent
+            ret=spi_link_submit(link, frame, res);
+            assert(ret==ESP_OK);
+            n++;
+            if (n%1000==0) {
+                print_link_stats();
+            }
+        }
+#endif
+        link_transfer(print_received);
+    }
+#endif
+
+    //Never reached.
+    ret=spi_bus_remove_device(handle);
+    assert(ret==ESP_OK);
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "spi_link_frame.h"
+#include "spi_link_pool.h"
+
+/**
+* @brief Link Type
+*
+* @note One end of the link: the master and the slave run the same protocol.
+*       Every transfer carries one frame in each direction. Payloads are
+*       numbered, and every frame acknowledges what has been received from the
+*       other side (cumulative ACK plus a bitmap of the frames received after
+*       a gap). Only the frames that are missing are sent again: when a later
+*       frame is acknowledged, when the other side reports a corrupted frame
+*       (NAK), or after a timeout. Duplicates are discarded on reception.
+*
+*       Payloads are delivered as soon as they are received, so after a
+*       retransmission they can be out of order.
+*
+*       The link is not thread-safe: use it from the task that queues the
+*       transactions.
+*/
+typedef struct spi_link_s spi_link_t;
+
+/**
+* @brief Link Configuration Type
+*
+* @note Time is counted in transfers. A frame can only be acknowledged some
+*       transfers after it has been sent, because both sides queue
+*       transactions in advance: `ack_latency` must be at least the number of
+*       transactions queued by the master plus those queued by the slave, plus 2.
+*/
+typedef struct {
+    spi_link_pool_t *pool;  /*!< Frame buffers (SPI_LINK_MAX_FRAME bytes). Needs `window` buffers, plus 2 for each transaction queued at once */
+    uint32_t window;        /*!< Frames sent and not acknowledged yet, at most: power of 2, up to 32 */
+    uint32_t ack_latency;   /*!< Transfers before a frame can be considered lost */
+    uint32_t retx_timeout;  /*!< Transfers before a frame not acknowledged is sent again anyway */
+    bool slave;             /*!< This end is the SPI slave, whose frames are cut if the master's transfer is shorter */
+    bool unpack;            /*!< The application can take compressed batches: tell the other side it may send them */
+} spi_link_config_t;
+
+/**
+* @brief Default configuration for a link
+*
+*/
+#define SPI_LINK_DEFAULT_CONFIG(pool_hdl) \
+    {                                     \
+        .pool = pool_hdl,                 \
+        .window = 8,                      \
+        .ack_latency = 8,                 \
+        .retx_timeout = 32,               \
+        .slave = false,                   \
+        .unpack = false,                  \
+    }
+
+/**
+* @brief Link statistics
+*
+*/
+typedef struct {
+    uint32_t tx_frames;      /*!< Payloads sent, including retransmissions */
+    uint32_t tx_retransmits; /*!< Payloads sent again */
+    uint32_t rx_frames;      /*!< Payloads delivered */
+    uint32_t rx_duplicates;  /*!< Payloads received again, and discarded */
+    uint32_t rx_crc_errors;  /*!< Corrupted frames */
+    uint32_t rx_truncated;   /*!< Frames longer than the transfer */
+    uint32_t rx_invalid;     /*!< Transfers without a frame */
+    uint32_t rx_refused;     /*!< Payloads refused for lack of room, see spi_link_set_rx_room() */
+    uint32_t tx_held;        /*!< Transfers that carried no payload because the other side was busy */
+    uint32_t tx_stretched;   /*!< Transfers made longer because the other side had more to send (master only) */
+    uint32_t tx_deferred;    /*!< Transfers that carried no payload because they were too short for it (slave only) */
+} spi_link_stats_t;
+
+/**
+* @brief No limit to the payloads the application can take, see spi_link_set_rx_room()
+*
+*/
+#define SPI_LINK_ROOM_UNLIMITED (UINT32_MAX)
+
+/**
+* @brief Create one end of a link
+*
+* @param config: link configuration
+* @param ret_link: returned link handle
+*
+* @return
+*      - ESP_OK: Link created successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_NO_MEM: Out of memory
+*/
+esp_err_t spi_link_new(const spi_link_config_t *config, spi_link_t **ret_link);
+
+/**
+* @brief Free the link, and give the frames not acknowledged yet back to the pool
+*
+* @param link: link handle
+*
+* @return
+*      - ESP_OK: Link freed successfully
+*/
+esp_err_t spi_link_del(spi_link_t *link);
+
+/**
+* @brief Whether a new payload can be submitted, i.e. the window isn't full
+*
+* @param link: link handle
+*/
+bool spi_link_can_submit(spi_link_t *link);
+
+/**
+* @brief Submit a payload
+*
+* The payload has been written in place in a frame buffer of the pool (see
+* spi_link_frame_payload()). The link owns the buffer from now on, and gives
+* it back to the pool when the other side acknowledges it.
+*
+* @param link: link handle
+* @param frame: frame buffer, acquired from the pool of the link
+* @param len: length of the payload
+*
+* @return
+*      - ESP_OK: Payload submitted successfully
+*      - ESP_ERR_INVALID_ARG: Payload too long
+*      - ESP_ERR_NO_MEM: The window is full, the buffer still belongs to the caller
+*/
+esp_err_t spi_link_submit(spi_link_t *link, uint8_t *frame, size_t len);
+
+/**
+* @brief Submit a payload, with flags telling the other side how to read it
+*
+* Same as spi_link_submit(), but the frame carries `flags` as well. The other
+* side finds them in the header of the received frame (see
+* spi_link_frame_header()).
+*
+* @param link: link handle
+* @param frame: frame buffer, acquired from the pool of the link
+* @param len: length of the payload
+* @param flags: 0 or SPI_LINK_FLAG_BATCH
+*
+* @return
+*      - ESP_OK: Payload submitted successfully
+*      - ESP_ERR_INVALID_ARG: Payload too long, or flags reserved to the link
+*      - ESP_ERR_NO_MEM: The window is full, the buffer still belongs to the caller
+*/
+esp_err_t spi_link_submit_flags(spi_link_t *link, uint8_t *frame, size_t len, uint8_t flags);
+
+/**
+* @brief Submit a payload that goes out before the others
+*
+* Same as spi_link_submit(), but the next frame prepared carries this payload,
+* ahead of the payloads submitted before and not sent yet, and of the ones to
+* send again. It still waits while the other side is busy.
+*
+* @param link: link handle
+* @param frame: frame buffer, acquired from the pool of the link
+* @param len: length of the payload
+*
+* @return
+*      - ESP_OK: Payload submitted successfully
+*      - ESP_ERR_INVALID_ARG: Payload too long
+*      - ESP_ERR_NO_MEM: The window is full, the buffer still belongs to the caller
+*/
+esp_err_t spi_link_submit_urgent(spi_link_t *link, uint8_t *frame, size_t len);
+
+/**
+* @brief Pick the frame to send with the next transfer
+*
+* A missing frame that must be sent again has the precedence, then the oldest
+* new one. When there's nothing to send, the frame only carries the
+* acknowledgements (such a frame is taken from the pool).
+*
+* The other side answers in the same transfer, so `size` can be more than the
+* frame: enough for a frame of the other side that didn't fit before, or for a
+* full frame while the other side says it has more to send
+* (SPI_LINK_FLAG_MORE). Only the master uses it.
+*
+* @param link: link handle
+* @param[out] size: number of bytes to transfer
+*
+* @return
+*      Frame to transfer, to be handed back with spi_link_tx_done() when the
+*      transfer is over
+*/
+uint8_t *spi_link_prepare_tx(spi_link_t *link, size_t *size);
+
+/**
+* @brief Hand back a frame returned by spi_link_prepare_tx(), once its transfer is over
+*
+* @param link: link handle
+* @param frame: frame returned by spi_link_prepare_tx()
+*/
+void spi_link_tx_done(spi_link_t *link, uint8_t *frame);
+
+/**
+* @brief Process a frame received from the other side
+*
+* @param link: link handle
+* @param frame: received frame
+* @param received: number of bytes actually transferred
+* @param[out] payload: new payload received, inside `frame`
+* @param[out] len: length of the payload
+*
+* @return
+*      - ESP_OK: A new payload has been received
+*      - ESP_ERR_NOT_FOUND: Valid frame, but no new payload (only acknowledgements, a duplicate, or a test
+*        pattern)
+*
+* @note A frame with SPI_LINK_FLAG_TEST is sent back as it is, with SPI_LINK_FLAG_ECHO, by the next call to
+*       spi_link_prepare_tx(), before anything else. This is how the master checks the wiring at a given clock
+*       rate, see spi_link_frame_finish() to build test frames.
+*      - ESP_ERR_INVALID_CRC, ESP_ERR_INVALID_SIZE, ESP_ERR_INVALID_RESPONSE: see spi_link_frame_parse()
+*/
+esp_err_t spi_link_process_rx(spi_link_t *link, const uint8_t *frame, size_t received, const uint8_t **payload,
+                              size_t *len);
+
+/**
+* @brief Tell how many more payloads the application can take
+*
+* Flow control for an application that hands the payloads over to a slower
+* consumer. Each payload accepted by spi_link_process_rx() takes one from
+* `room`. When `room` drops to `ack_latency` or less, the frames sent tell the
+* other side to stop sending payloads (SPI_LINK_FLAG_BUSY), so that the ones
+* already on their way still fit. When it drops to 0, the payloads that
+* arrive anyway are refused: they aren't acknowledged, so they are sent again
+* later. Call it before each spi_link_process_rx().
+*
+* @param link: link handle
+* @param room: payloads that can be taken from now on, or SPI_LINK_ROOM_UNLIMITED (the default)
+*/
+void spi_link_set_rx_room(spi_link_t *link, uint32_t room);
+
+/**
+* @brief Tell how many payloads the application has waiting to be submitted
+*
+* The link knows about the payloads submitted and not acknowledged yet, but
+* not about those still queued by the application, e.g. while the window is
+* full. As long as there are any of either, the frames sent are flagged
+* SPI_LINK_FLAG_MORE, and the master makes its transfers long enough for a
+* full frame instead of just for its own (see spi_link_prepare_tx()). On the
+* slave (see spi_link_config_t), a payload longer than the shortest transfer
+* of the master lately is kept back until longer transfers come, instead of
+* getting cut. Call it before each
+* spi_link_prepare_tx(); the default is 0.
+*
+* @param link: link handle
+* @param payloads: payloads waiting outside the link
+*/
+void spi_link_set_tx_backlog(spi_link_t *link, uint32_t payloads);
+
+/**
+* @brief Whether the other side can take compressed batches
+*
+* Every frame tells whether its sender can (SPI_LINK_FLAG_UNPACK, see
+* `unpack` in spi_link_config_t): false until a frame of the other side has
+* been received.
+*
+* @param link: link handle
+*/
+bool spi_link_peer_unpacks(spi_link_t *link);
+
+/**
+* @brief Whether there are payloads that haven't been acknowledged yet
+*
+* @param link: link handle
+*/
+bool spi_link_has_pending(spi_link_t *link);
+
+/**
+* @brief Get the link statistics
+*
+* @param link: link handle
+* @param[out] stats: statistics
+*/
+void spi_link_get_stats(spi_link_t *link, spi_link_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,205 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "spi_link.h"
+
+/**
+* @brief Size of the length prefix of each message in a batch
+*
+*/
+#define SPI_LINK_BATCH_PREFIX_SIZE (2)
+
+/**
+* @brief Largest message that fits in a batch
+*
+*/
+#define SPI_LINK_BATCH_MAX_MESSAGE (SPI_LINK_MAX_PAYLOAD - SPI_LINK_BATCH_PREFIX_SIZE)
+
+/**
+* @brief Batch Type
+*
+* @note Packs small messages into the payload of a single frame, so that they
+*       share a transfer (and its handshake, header and CRC) instead of taking
+*       one each. Each message is prefixed by its length (16 bits, little
+*       endian), and the frame is flagged with SPI_LINK_FLAG_BATCH, so that the
+*       other side knows to split it with spi_link_batch_next().
+*
+*       The open batch is submitted to the link when the next message doesn't
+*       fit, when its oldest message is older than the deadline (checked by
+*       spi_link_batch_poll()), or on spi_link_batch_flush().
+*
+*       With `pack`, a batch is compressed before it is submitted, if the other
+*       side can take it (see spi_link_peer_unpacks()) and if that makes it
+*       shorter. Each record (length prefix and message) is replaced by its
+*       byte-by-byte difference from the previous one, and the result is
+*       run-length encoded: telemetry that changes slowly becomes mostly runs
+*       of zeros. Every batch is compressed on its own, so frames can still be
+*       retransmitted and delivered out of order. A compressed batch starts
+*       with 0xFFFF, longer than any message: spi_link_batch_unpack() decodes
+*       it, and leaves the other batches as they are.
+*
+*       Like the link, a batch is not thread-safe: use it from the task that
+*       queues the transactions.
+*/
+typedef struct spi_link_batch_s spi_link_batch_t;
+
+/**
+* @brief Batch Configuration Type
+*
+*/
+typedef struct {
+    spi_link_t *link;       /*!< Link the batches are submitted to */
+    spi_link_pool_t *pool;  /*!< Pool of the link: the open batch takes one more buffer from it */
+    uint32_t deadline_us;   /*!< Longest time a message waits in the open batch, if spi_link_batch_poll() is called often enough */
+    bool pack;              /*!< Compress the batches when the other side can take them (takes SPI_LINK_MAX_PAYLOAD bytes of heap) */
+} spi_link_batch_config_t;
+
+/**
+* @brief Batch statistics
+*
+*/
+typedef struct {
+    uint32_t batches;        /*!< Batches submitted to the link */
+    uint32_t messages;       /*!< Messages in those batches */
+    uint32_t full;           /*!< Batches submitted because the next message didn't fit */
+    uint32_t deadline;       /*!< Batches submitted because of the deadline */
+    uint32_t flushed;        /*!< Batches submitted by spi_link_batch_flush() */
+    uint32_t packed;         /*!< Batches compressed */
+    uint64_t raw_bytes;      /*!< Bytes of the batches submitted, before compression */
+    uint64_t sent_bytes;     /*!< Bytes of the batches submitted, after compression */
+} spi_link_batch_stats_t;
+
+/**
+* @brief Create a batch in front of a link
+*
+* @param config: batch configuration
+* @param ret_batch: returned batch handle
+*
+* @return
+*      - ESP_OK: Batch created successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_NO_MEM: Out of memory
+*/
+esp_err_t spi_link_batch_new(const spi_link_batch_config_t *config, spi_link_batch_t **ret_batch);
+
+/**
+* @brief Free the batch, dropping the messages not submitted yet
+*
+* @param batch: batch handle
+*
+* @return
+*      - ESP_OK: Batch freed successfully
+*/
+esp_err_t spi_link_batch_del(spi_link_batch_t *batch);
+
+/**
+* @brief Append a message to the open batch
+*
+* The message is copied. If it doesn't fit, the open batch is submitted first,
+* and the message starts a new one.
+*
+* @param batch: batch handle
+* @param msg: message
+* @param len: length of the message, up to SPI_LINK_BATCH_MAX_MESSAGE
+*
+* @return
+*      - ESP_OK: Message added
+*      - ESP_ERR_INVALID_ARG: Message too long
+*      - ESP_ERR_NO_MEM: The open batch is full and the window of the link too: the message hasn't been added, try
+*        again after some transfers
+*/
+esp_err_t spi_link_batch_add(spi_link_batch_t *batch, const void *msg, size_t len);
+
+/**
+* @brief Submit the open batch, if it holds any message
+*
+* @param batch: batch handle
+*
+* @return
+*      - ESP_OK: Nothing left in the open batch
+*      - ESP_ERR_NO_MEM: The window of the link is full, the messages are still in the open batch
+*/
+esp_err_t spi_link_batch_flush(spi_link_batch_t *batch);
+
+/**
+* @brief Submit the open batch if its oldest message has waited longer than the deadline
+*
+* Call it before each transfer.
+*
+* @param batch: batch handle
+*
+* @return
+*      - ESP_OK: Submitted, or not due yet
+*      - ESP_ERR_NO_MEM: Due, but the window of the link is full
+*/
+esp_err_t spi_link_batch_poll(spi_link_batch_t *batch);
+
+/**
+* @brief Number of messages in the open batch, not submitted yet
+*
+* @param batch: batch handle
+*/
+uint32_t spi_link_batch_pending(spi_link_batch_t *batch);
+
+/**
+* @brief Get the batch statistics
+*
+* @param batch: batch handle
+* @param[out] stats: statistics
+*/
+void spi_link_batch_get_stats(spi_link_batch_t *batch, spi_link_batch_stats_t *stats);
+
+/**
+* @brief Decode a received batch, if it is compressed
+*
+* Call it before walking the batch with spi_link_batch_next(). A compressed
+* batch is decoded into `buf`, and `payload` and `len` are moved there; other
+* batches are left as they are.
+*
+* @param[inout] payload: payload of a frame flagged with SPI_LINK_FLAG_BATCH, see spi_link_process_rx()
+* @param[inout] len: length of the payload
+* @param buf: room for the decoded batch
+* @param buf_size: size of `buf`, SPI_LINK_MAX_PAYLOAD is enough for any batch
+*
+* @return
+*      - ESP_OK: The batch can be walked with spi_link_batch_next()
+*      - ESP_ERR_INVALID_SIZE: Malformed compressed batch, or larger than `buf`
+*/
+esp_err_t spi_link_batch_unpack(const uint8_t **payload, size_t *len, uint8_t *buf, size_t buf_size);
+
+/**
+* @brief Take the next message out of a received batch
+*
+* The payload and its length are moved past the message, so calling it until
+* it returns ESP_ERR_NOT_FOUND walks all the messages in the batch:
+*
+* @code{c}
+* if (spi_link_frame_header(frame)->flags & SPI_LINK_FLAG_BATCH &&
+*         spi_link_batch_unpack(&payload, &len, buf, sizeof(buf)) == ESP_OK) {
+*     while (spi_link_batch_next(&payload, &len, &msg, &msg_len) == ESP_OK) {
+*         handle(msg, msg_len);
+*     }
+* }
+* @endcode
+*
+* @param[inout] payload: payload of a frame flagged with SPI_LINK_FLAG_BATCH, see spi_link_process_rx()
+* @param[inout] len: bytes left in the payload
+* @param[out] msg: next message, inside the payload
+* @param[out] msg_len: length of the message
+*
+* @return
+*      - ESP_OK: A message has been taken
+*      - ESP_ERR_NOT_FOUND: No message left
+*      - ESP_ERR_INVALID_SIZE: The rest of the payload isn't a message (its length prefix goes past the end)
+*/
+esp_err_t spi_link_batch_next(const uint8_t **payload, size_t *len, const uint8_t **msg, size_t *msg_len);
+
+#ifdef __cplusplus
+}
+#endif
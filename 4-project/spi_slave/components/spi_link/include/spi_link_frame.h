@@ -0,0 +1,142 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/**
+* @brief First byte of every frame, to tell a frame from an idle or floating line
+*
+*/
+#define SPI_LINK_MAGIC (0xC3)
+
+/**
+* @brief Size of the frame header, i.e. the shortest possible transfer
+*
+*/
+#define SPI_LINK_HEADER_SIZE (16)
+
+/**
+* @brief Largest payload of a frame
+*
+*/
+#define SPI_LINK_MAX_PAYLOAD (CONFIG_SPI_LINK_MAX_PAYLOAD)
+
+/**
+* @brief Size of a buffer that can hold any frame (header, payload and padding)
+*
+*/
+#define SPI_LINK_MAX_FRAME (((SPI_LINK_HEADER_SIZE + SPI_LINK_MAX_PAYLOAD) + 3) & ~3)
+
+/**
+* @brief Flags of the frame header
+*
+*/
+#define SPI_LINK_FLAG_DATA   (1 << 0) /*!< The frame carries a payload, numbered by `seq` */
+#define SPI_LINK_FLAG_NAK    (1 << 1) /*!< The sender of the frame received a corrupted frame */
+#define SPI_LINK_FLAG_TEST   (1 << 2) /*!< Test pattern of the link training, to be sent back: no payload, no acks */
+#define SPI_LINK_FLAG_ECHO   (1 << 3) /*!< Test pattern sent back, with the `seq` and `len` it came with */
+#define SPI_LINK_FLAG_BATCH  (1 << 4) /*!< The payload is a batch of messages, see spi_link_batch.h */
+#define SPI_LINK_FLAG_BUSY   (1 << 5) /*!< The sender of the frame can't take new payloads for now */
+#define SPI_LINK_FLAG_MORE   (1 << 6) /*!< The sender of the frame has more payloads waiting: transfers should fit a full frame */
+#define SPI_LINK_FLAG_UNPACK (1 << 7) /*!< The sender of the frame can take compressed batches, see spi_link_batch.h */
+
+/**
+* @brief Frame header
+*
+* @note Every transfer starts with the header, so the receiving side always
+*       learns how long the payload is from the first bytes, whatever the
+*       length of the transfer. Every frame, with or without payload, also
+*       acknowledges the frames received from the other side: all the frames
+*       before `ack`, plus the ones in `sack`. All fields are little endian.
+*/
+typedef struct {
+    uint8_t magic;  /*!< Must be SPI_LINK_MAGIC */
+    uint8_t flags;  /*!< SPI_LINK_FLAG_xxx */
+    uint16_t len;   /*!< Length of the payload that follows the header */
+    uint16_t seq;   /*!< Sequence number of the payload (SPI_LINK_FLAG_DATA only) */
+    uint16_t ack;   /*!< Sequence number of the first frame not received yet */
+    uint32_t sack;  /*!< Bit i set: frame `ack + 1 + i` received */
+    uint32_t crc;   /*!< CRC-32 of the header up to here and of the payload */
+} spi_link_header_t;
+
+_Static_assert(sizeof(spi_link_header_t) == SPI_LINK_HEADER_SIZE, "unexpected padding in spi_link_header_t");
+
+/**
+* @brief Where the payload of a frame starts
+*
+* Payloads are written straight into the frame buffer, after the header.
+*
+* @param frame: frame buffer, at least SPI_LINK_MAX_FRAME bytes
+*
+* @return
+*      Start of the payload, room for SPI_LINK_MAX_PAYLOAD bytes
+*/
+static inline uint8_t *spi_link_frame_payload(uint8_t *frame)
+{
+    return frame + SPI_LINK_HEADER_SIZE;
+}
+
+/**
+* @brief Header of a frame
+*
+* @param frame: frame buffer, or a received frame that spi_link_frame_parse() validated
+*
+* @return
+*      Header, at the start of the frame
+*/
+static inline const spi_link_header_t *spi_link_frame_header(const uint8_t *frame)
+{
+    return (const spi_link_header_t *)frame;
+}
+
+/**
+* @brief Write the header of a frame whose payload is already in place
+*
+* @param frame: frame buffer (word aligned), at least SPI_LINK_MAX_FRAME bytes
+* @param header: flags, len (at most SPI_LINK_MAX_PAYLOAD), seq, ack and sack
+*                of the frame; magic and crc are filled in
+*
+* @return
+*      Number of bytes to transfer: header and payload, padded with zeros to a
+*      multiple of 4 bytes as DMA requires
+*/
+size_t spi_link_frame_finish(uint8_t *frame, const spi_link_header_t *header);
+
+/**
+* @brief Validate a received frame and locate its payload
+*
+* @param frame: received frame (word aligned)
+* @param received: number of bytes actually transferred
+* @param[out] header: header of the frame, inside the frame buffer
+* @param[out] payload: start of the payload, `(*header)->len` bytes
+*
+* @return
+*      - ESP_OK: Frame received in full and intact
+*      - ESP_ERR_INVALID_SIZE: The transfer was shorter than the frame
+*      - ESP_ERR_INVALID_CRC: The frame is corrupted
+*      - ESP_ERR_INVALID_RESPONSE: No frame at all (bad magic number or length, or shorter than a header)
+*/
+esp_err_t spi_link_frame_parse(const uint8_t *frame, size_t received, const spi_link_header_t **header,
+                               const uint8_t **payload);
+
+/**
+* @brief CRC-32 (IEEE 802.3), table driven, 4 bytes at a time (slicing-by-4)
+*
+* @param crc: 0, or the CRC of the previous data when computing it in pieces
+* @param data: data
+* @param len: length of data
+*
+* @return
+*      CRC of all the data so far
+*/
+uint32_t spi_link_crc32(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+* @brief Buffer pool Type
+*
+* @note A pool of fixed-size buffers allocated once in DMA-capable memory and
+*       word aligned, so the SPI drivers can use them as they are, without
+*       copying them into bounce buffers. Payloads are written straight into
+*       an acquired buffer, which is handed to the transaction and released
+*       when the transaction is done.
+*/
+typedef struct spi_link_pool_s spi_link_pool_t;
+
+/**
+* @brief Create a pool of DMA-capable buffers
+*
+* @param buf_num: number of buffers
+* @param buf_size: size of each buffer (rounded up to a multiple of 4 bytes)
+* @param ret_pool: returned pool handle
+*
+* @return
+*      - ESP_OK: Pool created successfully
+*      - ESP_ERR_INVALID_ARG: Invalid parameters
+*      - ESP_ERR_NO_MEM: Out of (DMA-capable) memory
+*/
+esp_err_t spi_link_pool_new(size_t buf_num, size_t buf_size, spi_link_pool_t **ret_pool);
+
+/**
+* @brief Free the pool and all its buffers
+*
+* @param pool: pool handle
+*
+* @return
+*      - ESP_OK: Pool freed successfully
+*/
+esp_err_t spi_link_pool_del(spi_link_pool_t *pool);
+
+/**
+* @brief Take a buffer from the pool
+*
+* @param pool: pool handle
+* @param ticks_to_wait: how long to wait for a buffer to be released when the pool is empty
+*
+* @return
+*      A buffer of the pool, or NULL if none got free in time
+*/
+uint8_t *spi_link_pool_acquire(spi_link_pool_t *pool, TickType_t ticks_to_wait);
+
+/**
+* @brief Give a buffer back to the pool
+*
+* @param pool: pool handle
+* @param buf: buffer taken with spi_link_pool_acquire()
+*/
+void spi_link_pool_release(spi_link_pool_t *pool, uint8_t *buf);
+
+/**
+* @brief Number of buffers currently free in the pool
+*
+* @param pool: pool handle
+*/
+size_t spi_link_pool_free_num(spi_link_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,433 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "spi_link.h"
+
+static const char *TAG = "spi_link";
+
+// A payload waiting for its acknowledgement
+typedef struct {
+    uint8_t *frame;     // NULL: free entry
+    uint16_t len;
+    uint16_t seq;
+    uint16_t inflight;  // transfers of this frame queued and not over yet
+    uint8_t flags;      // flags describing the payload (SPI_LINK_FLAG_BATCH)
+    bool urgent;        // goes out before the others
+    bool sent;          // sent at least once
+    bool acked;         // the other side has it: free as soon as it isn't in flight
+    bool retx;          // the other side reported a corrupted frame since it was sent
+    uint32_t last_sent; // transfer it was last sent with
+} tx_entry_t;
+
+struct spi_link_s {
+    spi_link_pool_t *pool;
+    uint32_t window;
+    uint32_t ack_latency;
+    uint32_t retx_timeout;
+    bool slave;
+    bool unpack;
+    uint32_t transfers;  // transfers prepared so far: the link clock
+    // Sending side
+    uint16_t tx_next;    // sequence number of the next payload submitted
+    bool peer_high_valid;
+    uint16_t peer_high;  // highest sequence number acknowledged by the other side
+    // Receiving side
+    uint16_t rx_next;    // all the payloads before this one have been received
+    uint32_t rx_mask;    // bit i: payload rx_next + 1 + i received
+    bool nak_pending;    // a corrupted frame has been received, tell the other side
+    size_t rx_size_hint; // transfer size needed by the last frame received truncated...
+    uint32_t rx_size_hint_at; // ...and when it was received
+    uint8_t *echo;       // test frame to send back, if any
+    uint32_t rx_room;    // payloads the application can still take
+    bool peer_busy;      // the other side can't take payloads: send only acknowledgements
+    bool peer_more;      // the other side has more to send: give it full frames
+    bool peer_unpack;    // the other side can take compressed batches
+    uint32_t tx_backlog; // payloads the application hasn't submitted yet
+    size_t rx_len_min;   // shortest transfer (as decided by the master) in the current period of ack_latency transfers...
+    size_t rx_len_prev;  // ...and in the previous one
+    uint32_t rx_len_period_at; // when the current period started
+    bool stretch_asked;  // a frame is kept until the transfers are long enough for it...
+    uint32_t stretch_asked_at; // ...since this transfer
+    spi_link_stats_t stats;
+    tx_entry_t entries[0]; // indexed by seq % window
+};
+
+static inline int16_t seq_diff(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b);
+}
+
+static void entry_free(spi_link_t *link, tx_entry_t *e)
+{
+    spi_link_pool_release(link->pool, e->frame);
+    e->frame = NULL;
+}
+
+esp_err_t spi_link_new(const spi_link_config_t *config, spi_link_t **ret_link)
+{
+    if (!config || !config->pool || !ret_link || !config->window || config->window > 32 ||
+            (config->window & (config->window - 1))) {
+        ESP_LOGE(TAG, "invalid configuration");
+        return ESP_ERR_INVALID_ARG;
+    }
+    spi_link_t *link = calloc(1, sizeof(spi_link_t) + config->window * sizeof(tx_entry_t));
+    if (!link) {
+        return ESP_ERR_NO_MEM;
+    }
+    link->pool = config->pool;
+    link->window = config->window;
+    link->ack_latency = config->ack_latency;
+    link->retx_timeout = config->retx_timeout;
+    link->slave = config->slave;
+    link->unpack = config->unpack;
+    link->rx_room = SPI_LINK_ROOM_UNLIMITED;
+    link->rx_len_min = SPI_LINK_MAX_FRAME;
+    link->rx_len_prev = SPI_LINK_MAX_FRAME;
+    *ret_link = link;
+    return ESP_OK;
+}
+
+esp_err_t spi_link_del(spi_link_t *link)
+{
+    for (uint32_t i = 0; i < link->window; i++) {
+        if (link->entries[i].frame) {
+            entry_free(link, &link->entries[i]);
+        }
+    }
+    if (link->echo) {
+        spi_link_pool_release(link->pool, link->echo);
+    }
+    free(link);
+    return ESP_OK;
+}
+
+bool spi_link_can_submit(spi_link_t *link)
+{
+    return link->entries[link->tx_next % link->window].frame == NULL;
+}
+
+esp_err_t spi_link_submit(spi_link_t *link, uint8_t *frame, size_t len)
+{
+    return spi_link_submit_flags(link, frame, len, 0);
+}
+
+// Take the next entry of the window for the payload
+static esp_err_t submit(spi_link_t *link, uint8_t *frame, size_t len, uint8_t flags, bool urgent)
+{
+    if (len > SPI_LINK_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The entry of tx_next is free only if the one of tx_next - window has been
+    // acknowledged: the other side never has to track more than `window` frames.
+    if (!spi_link_can_submit(link)) {
+        return ESP_ERR_NO_MEM;
+    }
+    tx_entry_t *e = &link->entries[link->tx_next % link->window];
+    *e = (tx_entry_t) {
+        .frame = frame,
+        .len = len,
+        .flags = flags,
+        .urgent = urgent,
+        .seq = link->tx_next++,
+    };
+    return ESP_OK;
+}
+
+esp_err_t spi_link_submit_flags(spi_link_t *link, uint8_t *frame, size_t len, uint8_t flags)
+{
+    if (flags & ~SPI_LINK_FLAG_BATCH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return submit(link, frame, len, flags, false);
+}
+
+esp_err_t spi_link_submit_urgent(spi_link_t *link, uint8_t *frame, size_t len)
+{
+    return submit(link, frame, len, 0, true);
+}
+
+// Whether the other side should have acknowledged the frame by now, but hasn't
+static bool entry_is_lost(spi_link_t *link, const tx_entry_t *e)
+{
+    if (!e->frame || e->acked || e->inflight || !e->sent) {
+        return false;
+    }
+    uint32_t age = link->transfers - e->last_sent;
+    if (age < link->ack_latency) {
+        // Its acknowledgement may still be on the way
+        return false;
+    }
+    // A later frame made it, or the other side got garbage: this one is missing.
+    // Otherwise, give up waiting after the timeout.
+    bool overtaken = link->peer_high_valid && seq_diff(e->seq, link->peer_high) < 0;
+    return overtaken || e->retx || age >= link->retx_timeout;
+}
+
+// Shortest transfer lately: the master may well make the next ones as short
+static size_t short_transfer(spi_link_t *link)
+{
+    return link->rx_len_min < link->rx_len_prev ? link->rx_len_min : link->rx_len_prev;
+}
+
+uint8_t *spi_link_prepare_tx(spi_link_t *link, size_t *size)
+{
+    link->transfers++;
+    if (link->echo) {
+        // Link training: send back the test pattern first, the rest can wait
+        uint8_t *frame = link->echo;
+        link->echo = NULL;
+        spi_link_header_t header = *(const spi_link_header_t *)frame;
+        header.flags = SPI_LINK_FLAG_ECHO;
+        *size = spi_link_frame_finish(frame, &header);
+        return frame;
+    }
+    // An urgent frame never sent, otherwise the oldest lost frame, otherwise
+    // the oldest one never sent
+    tx_entry_t *urgent = NULL, *lost = NULL, *fresh = NULL;
+    bool unacked = false;
+    for (uint32_t i = 0; i < link->window; i++) {
+        tx_entry_t *e = &link->entries[i];
+        unacked |= e->frame && !e->acked;
+        if (entry_is_lost(link, e)) {
+            if (!lost || seq_diff(e->seq, lost->seq) < 0) {
+                lost = e;
+            }
+        } else if (e->frame && !e->sent) {
+            if (e->urgent && (!urgent || seq_diff(e->seq, urgent->seq) < 0)) {
+                urgent = e;
+            }
+            if (!fresh || seq_diff(e->seq, fresh->seq) < 0) {
+                fresh = e;
+            }
+        }
+    }
+    tx_entry_t *e = urgent ? urgent : lost ? lost : fresh;
+    if (e && link->peer_busy) {
+        // It would be refused: keep it until the other side has room again
+        link->stats.tx_held++;
+        e = NULL;
+    }
+    if (e && link->slave && ((SPI_LINK_HEADER_SIZE + e->len + 3) & ~3) > short_transfer(link)) {
+        // It could be cut, the master decides the size: flag SPI_LINK_FLAG_MORE
+        // and keep it until the transfers are long enough, or until it's clear
+        // they won't be
+        if (!link->stretch_asked) {
+            link->stretch_asked = true;
+            link->stretch_asked_at = link->transfers;
+        }
+        if (link->transfers - link->stretch_asked_at < link->retx_timeout) {
+            link->stats.tx_deferred++;
+            e = NULL;
+        }
+    } else {
+        link->stretch_asked = false;
+    }
+
+    spi_link_header_t header = {
+        .flags = (link->nak_pending ? SPI_LINK_FLAG_NAK : 0) | (link->unpack ? SPI_LINK_FLAG_UNPACK : 0),
+        .ack = link->rx_next,
+        .sack = link->rx_mask,
+    };
+    link->nak_pending = false;
+    // The payloads already on their way (up to ack_latency transfers of them)
+    // must still fit when the other side sees this
+    if (link->rx_room <= link->ack_latency) {
+        header.flags |= SPI_LINK_FLAG_BUSY;
+    }
+    // Payloads still on their way: keep the transfers long until they are all
+    // acknowledged, including the ones already in frames prepared in advance
+    // (not worth asking while the other side can't take them)
+    if (!link->peer_busy && (unacked || link->tx_backlog)) {
+        header.flags |= SPI_LINK_FLAG_MORE;
+    }
+    uint8_t *frame;
+    if (e) {
+        header.flags |= SPI_LINK_FLAG_DATA | e->flags;
+        header.len = e->len;
+        header.seq = e->seq;
+        frame = e->frame;
+        link->stats.tx_frames++;
+        if (e->sent) {
+            link->stats.tx_retransmits++;
+        }
+        e->sent = true;
+        e->retx = false;
+        e->inflight++;
+        e->last_sent = link->transfers;
+    } else {
+        // Nothing to send: only the acknowledgements
+        frame = spi_link_pool_acquire(link->pool, portMAX_DELAY);
+    }
+    *size = spi_link_frame_finish(frame, &header);
+    // The other side answers in the same transfer: make it long enough for
+    // the frame that didn't fit, until it has surely been sent again (only the
+    // master decides the size)
+    if (link->transfers - link->rx_size_hint_at > link->retx_timeout + link->ack_latency) {
+        link->rx_size_hint = 0;
+    }
+    if (*size < link->rx_size_hint) {
+        *size = link->rx_size_hint;
+    }
+    // Same when the other side has more payloads waiting: they are likely
+    // longer than our frame
+    if (!link->slave && link->peer_more && *size < SPI_LINK_MAX_FRAME) {
+        *size = SPI_LINK_MAX_FRAME;
+        link->stats.tx_stretched++;
+    }
+    return frame;
+}
+
+void spi_link_tx_done(spi_link_t *link, uint8_t *frame)
+{
+    for (uint32_t i = 0; i < link->window; i++) {
+        tx_entry_t *e = &link->entries[i];
+        if (e->frame == frame) {
+            e->inflight--;
+            if (e->acked && !e->inflight) {
+                entry_free(link, e);
+            }
+            return;
+        }
+    }
+    // Not a payload: a frame with only acknowledgements
+    spi_link_pool_release(link->pool, frame);
+}
+
+static void process_ack(spi_link_t *link, const spi_link_header_t *header)
+{
+    for (uint32_t i = 0; i < link->window; i++) {
+        tx_entry_t *e = &link->entries[i];
+        if (!e->frame || e->acked) {
+            continue;
+        }
+        int16_t d = seq_diff(e->seq, header->ack);
+        if (d < 0 || (d >= 1 && d <= 32 && (header->sack & (1UL << (d - 1))))) {
+            e->acked = true;
+            if (!link->peer_high_valid || seq_diff(e->seq, link->peer_high) > 0) {
+                link->peer_high = e->seq;
+                link->peer_high_valid = true;
+            }
+            if (!e->inflight) {
+                entry_free(link, e);
+            }
+        } else if ((header->flags & SPI_LINK_FLAG_NAK) && e->sent) {
+            // The corrupted frame could be any of those not acknowledged
+            e->retx = true;
+        }
+    }
+}
+
+esp_err_t spi_link_process_rx(spi_link_t *link, const uint8_t *frame, size_t received, const uint8_t **payload,
+                              size_t *len)
+{
+    const spi_link_header_t *header;
+    esp_err_t ret = spi_link_frame_parse(frame, received, &header, payload);
+    if (link->transfers - link->rx_len_period_at >= link->ack_latency) {
+        link->rx_len_prev = link->rx_len_min;
+        link->rx_len_min = received;
+        link->rx_len_period_at = link->transfers;
+    } else if (received < link->rx_len_min) {
+        link->rx_len_min = received;
+    }
+    switch (ret) {
+    case ESP_OK:
+        break;
+    case ESP_ERR_INVALID_CRC:
+        link->stats.rx_crc_errors++;
+        link->nak_pending = true;
+        return ret;
+    case ESP_ERR_INVALID_SIZE:
+        // Not corrupted: the transfer was just too short, the frame will be sent
+        // again. Its length can't be verified, but it's only used as a hint.
+        link->stats.rx_truncated++;
+        size_t hint = (SPI_LINK_HEADER_SIZE + ((const spi_link_header_t *)frame)->len + 3) & ~3;
+        if (hint > link->rx_size_hint) {
+            link->rx_size_hint = hint;
+        }
+        link->rx_size_hint_at = link->transfers;
+        return ret;
+    default:
+        link->stats.rx_invalid++;
+        return ret;
+    }
+    if (header->flags & SPI_LINK_FLAG_TEST) {
+        // Kept until the next spi_link_prepare_tx(). If no buffer is free, the
+        // master just sees a missing echo.
+        if (!link->echo) {
+            link->echo = spi_link_pool_acquire(link->pool, 0);
+        }
+        if (link->echo) {
+            memcpy(link->echo, frame, SPI_LINK_HEADER_SIZE + header->len);
+        }
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (header->flags & SPI_LINK_FLAG_ECHO) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    process_ack(link, header);
+    link->peer_busy = header->flags & SPI_LINK_FLAG_BUSY;
+    link->peer_more = header->flags & SPI_LINK_FLAG_MORE;
+    link->peer_unpack = header->flags & SPI_LINK_FLAG_UNPACK;
+    if (!(header->flags & SPI_LINK_FLAG_DATA)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int16_t d = seq_diff(header->seq, link->rx_next);
+    if (d < 0 || d > 32 || (d > 0 && (link->rx_mask & (1UL << (d - 1))))) {
+        // Already received (or too far ahead to be tracked, which a correct peer never does)
+        link->stats.rx_duplicates++;
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (link->rx_room == 0) {
+        // Neither delivered nor acknowledged: the other side sends it again later
+        link->stats.rx_refused++;
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (link->rx_room != SPI_LINK_ROOM_UNLIMITED) {
+        link->rx_room--;
+    }
+    if (d == 0) {
+        // Move rx_next past this payload and past those received after the gap it closes
+        link->rx_next++;
+        while (link->rx_mask & 1) {
+            link->rx_mask >>= 1;
+            link->rx_next++;
+        }
+        link->rx_mask >>= 1;
+    } else {
+        link->rx_mask |= 1UL << (d - 1);
+    }
+    link->stats.rx_frames++;
+    *len = header->len;
+    return ESP_OK;
+}
+
+void spi_link_set_tx_backlog(spi_link_t *link, uint32_t payloads)
+{
+    link->tx_backlog = payloads;
+}
+
+bool spi_link_peer_unpacks(spi_link_t *link)
+{
+    return link->peer_unpack;
+}
+
+bool spi_link_has_pending(spi_link_t *link)
+{
+    for (uint32_t i = 0; i < link->window; i++) {
+        if (link->entries[i].frame && !link->entries[i].acked) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void spi_link_set_rx_room(spi_link_t *link, uint32_t room)
+{
+    link->rx_room = room;
+}
+
+void spi_link_get_stats(spi_link_t *link, spi_link_stats_t *stats)
+{
+    *stats = link->stats;
+}
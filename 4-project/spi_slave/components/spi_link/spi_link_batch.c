@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "spi_link_batch.h"
+
+static const char *TAG = "spi_link_batch";
+
+// A compressed batch: mark, length once decoded, then the records delta and
+// run-length encoded
+#define PACKED_MARK 0xFFFF
+#define PACKED_HEADER_SIZE 4
+
+// Run-length encoding, PackBits style: a control byte below 0x80 is followed
+// by that many literal bytes plus one, one from 0x80 up by a single byte to
+// repeat RLE_MIN_RUN times plus (control - 0x80)
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN (0x7F + RLE_MIN_RUN)
+#define RLE_MAX_LITERAL 0x80
+
+struct spi_link_batch_s {
+    spi_link_t *link;
+    spi_link_pool_t *pool;
+    uint32_t deadline_us;
+    uint8_t *scratch;   // SPI_LINK_MAX_PAYLOAD bytes to compress into, NULL if `pack` is off
+    uint8_t *frame;     // open batch, NULL until its first message
+    size_t len;         // bytes of the payload written so far
+    uint32_t count;     // messages in it
+    int64_t opened_at;  // when its first message was added
+    spi_link_batch_stats_t stats;
+};
+
+esp_err_t spi_link_batch_new(const spi_link_batch_config_t *config, spi_link_batch_t **ret_batch)
+{
+    if (!config || !config->link || !config->pool || !ret_batch) {
+        ESP_LOGE(TAG, "invalid configuration");
+        return ESP_ERR_INVALID_ARG;
+    }
+    spi_link_batch_t *batch = calloc(1, sizeof(spi_link_batch_t));
+    if (!batch) {
+        return ESP_ERR_NO_MEM;
+    }
+    batch->link = config->link;
+    batch->pool = config->pool;
+    batch->deadline_us = config->deadline_us;
+    if (config->pack) {
+        batch->scratch = malloc(SPI_LINK_MAX_PAYLOAD);
+        if (!batch->scratch) {
+            free(batch);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    *ret_batch = batch;
+    return ESP_OK;
+}
+
+esp_err_t spi_link_batch_del(spi_link_batch_t *batch)
+{
+    if (batch->frame) {
+        spi_link_pool_release(batch->pool, batch->frame);
+    }
+    free(batch->scratch);
+    free(batch);
+    return ESP_OK;
+}
+
+// Each record (length prefix and message) minus the previous one, byte by
+// byte: successive readings of a sensor differ in a few digits, the rest turns
+// into runs of zeros. The records are those of a batch built here, so they
+// are well formed.
+static void delta_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    const uint8_t *prev = NULL;
+    size_t prev_len = 0;
+    for (size_t p = 0; p < len;) {
+        size_t rec = SPI_LINK_BATCH_PREFIX_SIZE + (in[p] | (in[p + 1] << 8));
+        for (size_t i = 0; i < rec; i++) {
+            out[p + i] = in[p + i] - (i < prev_len ? prev[i] : 0);
+        }
+        prev = in + p;
+        prev_len = rec;
+        p += rec;
+    }
+}
+
+// Undo delta_encode() in place: each record is restored before the next one
+// needs it
+static esp_err_t delta_decode(uint8_t *buf, size_t len)
+{
+    const uint8_t *prev = NULL;
+    size_t prev_len = 0;
+    for (size_t p = 0; p < len;) {
+        if (len - p < SPI_LINK_BATCH_PREFIX_SIZE) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        for (size_t i = 0; i < SPI_LINK_BATCH_PREFIX_SIZE; i++) {
+            buf[p + i] += i < prev_len ? prev[i] : 0;
+        }
+        size_t rec = SPI_LINK_BATCH_PREFIX_SIZE + (buf[p] | (buf[p + 1] << 8));
+        if (rec > len - p) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        for (size_t i = SPI_LINK_BATCH_PREFIX_SIZE; i < rec; i++) {
+            buf[p + i] += i < prev_len ? prev[i] : 0;
+        }
+        prev = buf + p;
+        prev_len = rec;
+        p += rec;
+    }
+    return ESP_OK;
+}
+
+// Run-length encode `in` into `out`, or just count the bytes if `out` is NULL
+static size_t rle_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len;) {
+        size_t run = 1;
+        while (i + run < len && run < RLE_MAX_RUN && in[i + run] == in[i]) {
+            run++;
+        }
+        if (run >= RLE_MIN_RUN) {
+            if (out) {
+                out[n] = 0x80 + run - RLE_MIN_RUN;
+                out[n + 1] = in[i];
+            }
+            n += 2;
+            i += run;
+            continue;
+        }
+        // Literals, up to the next run worth encoding
+        size_t start = i;
+        while (i < len && i - start < RLE_MAX_LITERAL &&
+                !(i + 2 < len && in[i] == in[i + 1] && in[i] == in[i + 2])) {
+            i++;
+        }
+        if (out) {
+            out[n] = i - start - 1;
+            memcpy(out + n + 1, in + start, i - start);
+        }
+        n += 1 + i - start;
+    }
+    return n;
+}
+
+static esp_err_t rle_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len;) {
+        uint8_t c = in[i++];
+        if (c < 0x80) {
+            size_t lit = c + 1;
+            if (lit > len - i || lit > out_len - n) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(out + n, in + i, lit);
+            i += lit;
+            n += lit;
+        } else {
+            size_t run = c - 0x80 + RLE_MIN_RUN;
+            if (i == len || run > out_len - n) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memset(out + n, in[i++], run);
+            n += run;
+        }
+    }
+    return n == out_len ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+// Compress the open batch in place, if that makes it shorter
+static void batch_pack(spi_link_batch_t *batch)
+{
+    uint8_t *payload = spi_link_frame_payload(batch->frame);
+    delta_encode(payload, batch->len, batch->scratch);
+    size_t packed = PACKED_HEADER_SIZE + rle_encode(batch->scratch, batch->len, NULL);
+    if (packed >= batch->len) {
+        return;
+    }
+    payload[0] = PACKED_MARK & 0xFF;
+    payload[1] = PACKED_MARK >> 8;
+    payload[2] = batch->len & 0xFF;
+    payload[3] = batch->len >> 8;
+    rle_encode(batch->scratch, batch->len, payload + PACKED_HEADER_SIZE);
+    batch->stats.packed++;
+    batch->len = packed;
+}
+
+// Hand the open batch over to the link, counting why in `reason`
+static esp_err_t batch_submit(spi_link_batch_t *batch, uint32_t *reason)
+{
+    // Once compressed, the batch can't take more messages: check the window first
+    if (!spi_link_can_submit(batch->link)) {
+        return ESP_ERR_NO_MEM;
+    }
+    batch->stats.raw_bytes += batch->len;
+    if (batch->scratch && spi_link_peer_unpacks(batch->link)) {
+        batch_pack(batch);
+    }
+    batch->stats.sent_bytes += batch->len;
+    esp_err_t ret = spi_link_submit_flags(batch->link, batch->frame, batch->len, SPI_LINK_FLAG_BATCH);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    batch->stats.batches++;
+    batch->stats.messages += batch->count;
+    (*reason)++;
+    batch->frame = NULL;
+    return ESP_OK;
+}
+
+esp_err_t spi_link_batch_add(spi_link_batch_t *batch, const void *msg, size_t len)
+{
+    if (len > SPI_LINK_BATCH_MAX_MESSAGE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (batch->frame && batch->len + SPI_LINK_BATCH_PREFIX_SIZE + len > SPI_LINK_MAX_PAYLOAD) {
+        esp_err_t ret = batch_submit(batch, &batch->stats.full);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (!batch->frame) {
+        batch->frame = spi_link_pool_acquire(batch->pool, portMAX_DELAY);
+        batch->len = 0;
+        batch->count = 0;
+        batch->opened_at = esp_timer_get_time();
+    }
+    uint8_t *p = spi_link_frame_payload(batch->frame) + batch->len;
+    p[0] = len & 0xFF;
+    p[1] = len >> 8;
+    memcpy(p + SPI_LINK_BATCH_PREFIX_SIZE, msg, len);
+    batch->len += SPI_LINK_BATCH_PREFIX_SIZE + len;
+    batch->count++;
+    return ESP_OK;
+}
+
+esp_err_t spi_link_batch_flush(spi_link_batch_t *batch)
+{
+    if (!batch->frame) {
+        return ESP_OK;
+    }
+    return batch_submit(batch, &batch->stats.flushed);
+}
+
+esp_err_t spi_link_batch_poll(spi_link_batch_t *batch)
+{
+    if (!batch->frame || esp_timer_get_time() - batch->opened_at < batch->deadline_us) {
+        return ESP_OK;
+    }
+    return batch_submit(batch, &batch->stats.deadline);
+}
+
+uint32_t spi_link_batch_pending(spi_link_batch_t *batch)
+{
+    return batch->frame ? batch->count : 0;
+}
+
+void spi_link_batch_get_stats(spi_link_batch_t *batch, spi_link_batch_stats_t *stats)
+{
+    *stats = batch->stats;
+}
+
+esp_err_t spi_link_batch_unpack(const uint8_t **payload, size_t *len, uint8_t *buf, size_t buf_size)
+{
+    const uint8_t *p = *payload;
+    if (*len < SPI_LINK_BATCH_PREFIX_SIZE || (p[0] | (p[1] << 8)) != PACKED_MARK) {
+        // Not compressed
+        return ESP_OK;
+    }
+    if (*len < PACKED_HEADER_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t raw_len = p[2] | (p[3] << 8);
+    if (raw_len > buf_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t ret = rle_decode(p + PACKED_HEADER_SIZE, *len - PACKED_HEADER_SIZE, buf, raw_len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = delta_decode(buf, raw_len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *payload = buf;
+    *len = raw_len;
+    return ESP_OK;
+}
+
+esp_err_t spi_link_batch_next(const uint8_t **payload, size_t *len, const uint8_t **msg, size_t *msg_len)
+{
+    if (*len == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (*len < SPI_LINK_BATCH_PREFIX_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *p = *payload;
+    size_t n = p[0] | (p[1] << 8);
+    if (n > *len - SPI_LINK_BATCH_PREFIX_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *msg = p + SPI_LINK_BATCH_PREFIX_SIZE;
+    *msg_len = n;
+    *payload += SPI_LINK_BATCH_PREFIX_SIZE + n;
+    *len -= SPI_LINK_BATCH_PREFIX_SIZE + n;
+    return ESP_OK;
+}
@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <string.h>
+#include "spi_link_frame.h"
+
+// Bytes of the header covered by the CRC: all but the CRC itself
+#define CRC_HEADER_BYTES (offsetof(spi_link_header_t, crc))
+
+// crc_table[0] is the classic byte-wise table. crc_table[k][i] is the CRC of
+// byte i followed by k zero bytes, so that 4 table lookups process 4 bytes.
+static uint32_t crc_table[4][256];
+static bool crc_table_ready;
+
+static void crc_table_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 4; k++) {
+            crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xFF];
+        }
+    }
+    // Filling the tables twice (e.g. from two tasks) is harmless
+    crc_table_ready = true;
+}
+
+uint32_t spi_link_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    if (!crc_table_ready) {
+        crc_table_init();
+    }
+    crc = ~crc;
+    // Byte-wise up to a word boundary, then a word at a time
+    while (len && ((uintptr_t)p & 3)) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+    while (len >= 4) {
+        crc ^= *(const uint32_t *)p; // little endian
+        crc = crc_table[3][crc & 0xFF] ^ crc_table[2][(crc >> 8) & 0xFF] ^
+              crc_table[1][(crc >> 16) & 0xFF] ^ crc_table[0][crc >> 24];
+        p += 4;
+        len -= 4;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+size_t spi_link_frame_finish(uint8_t *frame, const spi_link_header_t *header)
+{
+    spi_link_header_t *h = (spi_link_header_t *)frame;
+    *h = *header;
+    h->magic = SPI_LINK_MAGIC;
+    if (h->len > SPI_LINK_MAX_PAYLOAD) {
+        h->len = SPI_LINK_MAX_PAYLOAD;
+    }
+    h->crc = spi_link_crc32(spi_link_crc32(0, frame, CRC_HEADER_BYTES), frame + SPI_LINK_HEADER_SIZE, h->len);
+    size_t size = (SPI_LINK_HEADER_SIZE + h->len + 3) & ~3;
+    memset(frame + SPI_LINK_HEADER_SIZE + h->len, 0, size - SPI_LINK_HEADER_SIZE - h->len);
+    return size;
+}
+
+esp_err_t spi_link_frame_parse(const uint8_t *frame, size_t received, const spi_link_header_t **header,
+                               const uint8_t **payload)
+{
+    const spi_link_header_t *h = (const spi_link_header_t *)frame;
+    if (received < SPI_LINK_HEADER_SIZE || h->magic != SPI_LINK_MAGIC || h->len > SPI_LINK_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (SPI_LINK_HEADER_SIZE + h->len > received) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (spi_link_crc32(spi_link_crc32(0, frame, CRC_HEADER_BYTES), frame + SPI_LINK_HEADER_SIZE, h->len) != h->crc) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    *header = h;
+    *payload = frame + SPI_LINK_HEADER_SIZE;
+    return ESP_OK;
+}
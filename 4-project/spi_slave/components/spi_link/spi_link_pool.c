@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/queue.h"
+#include "spi_link_pool.h"
+
+static const char *TAG = "spi_link_pool";
+
+struct spi_link_pool_s {
+    uint8_t *memory;    // all the buffers, in one DMA-capable block
+    QueueHandle_t free; // pointers to the free buffers
+};
+
+esp_err_t spi_link_pool_new(size_t buf_num, size_t buf_size, spi_link_pool_t **ret_pool)
+{
+    if (!buf_num || !buf_size || !ret_pool) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Word aligned buffers: the DMA moves whole words
+    buf_size = (buf_size + 3) & ~3;
+    spi_link_pool_t *pool = calloc(1, sizeof(spi_link_pool_t));
+    if (!pool) {
+        goto err;
+    }
+    pool->memory = heap_caps_malloc(buf_num * buf_size, MALLOC_CAP_DMA);
+    pool->free = xQueueCreate(buf_num, sizeof(uint8_t *));
+    if (!pool->memory || !pool->free) {
+        goto err;
+    }
+    for (size_t i = 0; i < buf_num; i++) {
+        uint8_t *buf = pool->memory + i * buf_size;
+        xQueueSend(pool->free, &buf, 0);
+    }
+    *ret_pool = pool;
+    return ESP_OK;
+err:
+    ESP_LOGE(TAG, "can't allocate %u buffers of %u bytes", (unsigned)buf_num, (unsigned)buf_size);
+    if (pool) {
+        spi_link_pool_del(pool);
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t spi_link_pool_del(spi_link_pool_t *pool)
+{
+    if (pool->free) {
+        vQueueDelete(pool->free);
+    }
+    heap_caps_free(pool->memory);
+    free(pool);
+    return ESP_OK;
+}
+
+uint8_t *spi_link_pool_acquire(spi_link_pool_t *pool, TickType_t ticks_to_wait)
+{
+    uint8_t *buf = NULL;
+    if (xQueueReceive(pool->free, &buf, ticks_to_wait) != pdTRUE) {
+        return NULL;
+    }
+    return buf;
+}
+
+void spi_link_pool_release(spi_link_pool_t *pool, uint8_t *buf)
+{
+    // Never blocks: the queue has room for all the buffers of the pool
+    xQueueSend(pool->free, &buf, 0);
+}
+
+size_t spi_link_pool_free_num(spi_link_pool_t *pool)
+{
+    return uxQueueMessagesWaiting(pool->free);
+}